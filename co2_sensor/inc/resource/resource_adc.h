@@ -0,0 +1,43 @@
+/*
+ * Copyright (c) 2018 Samsung Electronics Co., Ltd.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an AS IS BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef _RESOURCE_ADC_H_
+#define _RESOURCE_ADC_H_
+
+#define ADC_FRAME_LEN_MAX	4		// bytes per conversion frame
+
+typedef struct __adc_driver__ {		// one spi adc chip, the spi plumbing is in resource_adc_driver.c
+	const char *name;
+	int bits;						// resolution of one conversion
+	int channels;
+	unsigned int speed_hz;			// spi clock limit of the chip
+	int frame_len;					// bytes per conversion, up to ADC_FRAME_LEN_MAX
+	void (*encode)(int ch_num, unsigned char *tx);		// conversion request frame
+	int (*decode)(const unsigned char *rx, unsigned int *out_value);	// 0, -1 if the frame is bad
+} adc_driver_t;
+
+extern const adc_driver_t adc_driver_mcp3008;	/* resource_adc_mcp3008.c */
+extern const adc_driver_t adc_driver_mcp3208;	/* resource_adc_mcp3208.c */
+
+const adc_driver_t *resource_adc_find_driver(const char *name);
+int resource_adc_set_driver(const char *name);
+const adc_driver_t *resource_adc_get_driver(void);
+int resource_adc_driver_init(const adc_driver_t *driver);
+int resource_adc_driver_read(const adc_driver_t *driver, int ch_num, unsigned int *out_value);
+int resource_adc_driver_read_block(const adc_driver_t *driver, int ch_num, unsigned int out_value[], int n);
+void resource_adc_driver_fini(const adc_driver_t *driver);
+
+#endif /* _RESOURCE_ADC_H_ */
@@ -0,0 +1,26 @@
+/*
+ * Copyright (c) 2018 Samsung Electronics Co., Ltd.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an AS IS BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef _RESOURCE_ADC_DECIMATE_H_
+#define _RESOURCE_ADC_DECIMATE_H_
+
+#define ADC_OUTPUT_BITS		12		// resolution of decimated samples
+#define ADC_DECIMATE		16		// max raw samples per output, 10bit: 4^2 for 2 more bits
+
+int adc_decimate_factor(int bits);
+void adc_decimate(const short *in, int nblocks, int bits, short *out);
+
+#endif /* _RESOURCE_ADC_DECIMATE_H_ */
@@ -0,0 +1,33 @@
+/*
+ * Copyright (c) 2018 Samsung Electronics Co., Ltd.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an AS IS BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef _RESOURCE_ADC_RANK_H_
+#define _RESOURCE_ADC_RANK_H_
+
+#define ADC_RANK_SIZE	4096		// adc value range 0 ~ 4095, power of 2
+
+typedef struct __adc_rank__ {		// order statistics of the window samples
+	int total;						// samples counted
+	int count[ADC_RANK_SIZE + 1];	// fenwick tree of sample count per value
+	int sum[ADC_RANK_SIZE + 1];		// fenwick tree of sample sum per value
+} adc_rank_t;
+
+void adc_rank_reset(adc_rank_t *rank);
+void adc_rank_update(adc_rank_t *rank, int value, int delta);
+int adc_rank_select(adc_rank_t *rank, int k);
+long long adc_rank_sum_smallest(adc_rank_t *rank, int k);
+
+#endif /* _RESOURCE_ADC_RANK_H_ */
@@ -0,0 +1,113 @@
+/*
+ * Copyright (c) 2018 Samsung Electronics Co., Ltd.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an AS IS BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef _RESOURCE_ADC_RING_H_
+#define _RESOURCE_ADC_RING_H_
+
+#include <string.h>
+
+#define CACHE_LINE_SIZE	64
+#define ADC_RING_SIZE	2048		// sample ring size, must be power of 2
+#define ADC_RING_MASK	(ADC_RING_SIZE - 1)
+
+/*
+ * single producer / single consumer adc sample ring without lock.
+ * the producer (sampler thread) never waits for the consumer: when the
+ * consumer falls behind, the oldest samples are overwritten and the
+ * consumer skips them on the next pop.
+ */
+typedef struct __adc_ring__ {
+	unsigned int head __attribute__((aligned(CACHE_LINE_SIZE)));	// next write index, producer only
+	unsigned int reset;				// bumped by producer to discard old samples
+	unsigned int tail __attribute__((aligned(CACHE_LINE_SIZE)));	// next read index, consumer only
+	unsigned int lost;				// samples overwritten before read
+	short sample[ADC_RING_SIZE] __attribute__((aligned(CACHE_LINE_SIZE)));
+} adc_ring_t;
+
+/*
+ * producer: append one sample
+ */
+static inline void adc_ring_push(adc_ring_t *ring, short value)
+{
+	unsigned int head = __atomic_load_n(&ring->head, __ATOMIC_RELAXED);
+
+	__atomic_store_n(&ring->sample[head & ADC_RING_MASK], value, __ATOMIC_RELAXED);
+	__atomic_store_n(&ring->head, head + 1, __ATOMIC_RELEASE);
+}
+
+/*
+ * producer: ask the consumer to drop everything it has collected so far
+ */
+static inline void adc_ring_reset(adc_ring_t *ring)
+{
+	__atomic_add_fetch(&ring->reset, 1, __ATOMIC_RELEASE);
+}
+
+/*
+ * producer or monitor: total number of samples pushed (wraps)
+ */
+static inline unsigned int adc_ring_head(adc_ring_t *ring)
+{
+	return __atomic_load_n(&ring->head, __ATOMIC_ACQUIRE);
+}
+
+/*
+ * consumer: drop every unread sample
+ */
+static inline void adc_ring_skip(adc_ring_t *ring)
+{
+	__atomic_store_n(&ring->tail, __atomic_load_n(&ring->head, __ATOMIC_ACQUIRE), __ATOMIC_RELEASE);
+}
+
+/*
+ * consumer: copy up to max unread samples (oldest first) into out.
+ * returns the number of samples copied.
+ */
+static inline int adc_ring_pop(adc_ring_t *ring, short *out, int max)
+{
+	unsigned int tail = __atomic_load_n(&ring->tail, __ATOMIC_RELAXED);
+	unsigned int head = __atomic_load_n(&ring->head, __ATOMIC_ACQUIRE);
+	unsigned int n, i, over;
+
+	if (head - tail > ADC_RING_SIZE) {	// producer lapped us
+		ring->lost += head - tail - ADC_RING_SIZE;
+		tail = head - ADC_RING_SIZE;
+	}
+	n = head - tail;
+	if (n > (unsigned int)max)
+		n = max;
+
+	for (i = 0; i < n; i++)
+		out[i] = __atomic_load_n(&ring->sample[(tail + i) & ADC_RING_MASK], __ATOMIC_RELAXED);
+
+	// drop the slots the producer may have rewritten while we were copying
+	__atomic_thread_fence(__ATOMIC_ACQUIRE);
+	head = __atomic_load_n(&ring->head, __ATOMIC_RELAXED);
+	over = 0;
+	if (head - tail > ADC_RING_SIZE) {
+		over = head - tail - ADC_RING_SIZE;
+		if (over > n)
+			over = n;
+		memmove(out, out + over, (n - over) * sizeof(short));
+		ring->lost += over;
+	}
+
+	__atomic_store_n(&ring->tail, tail + n, __ATOMIC_RELEASE);
+
+	return n - over;
+}
+
+#endif /* _RESOURCE_ADC_RING_H_ */
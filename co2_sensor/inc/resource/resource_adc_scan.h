@@ -0,0 +1,88 @@
+/*
+ * Copyright (c) 2018 Samsung Electronics Co., Ltd.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an AS IS BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef _RESOURCE_ADC_SCAN_H_
+#define _RESOURCE_ADC_SCAN_H_
+
+#include "resource/resource_adc_ring.h"
+#include "resource/resource_adc_rank.h"
+#include "resource/resource_adc_decimate.h"
+
+#define ADC_CHANNEL_MAX	8			// mcp3x08 channels
+#define ADC_MAX_SIZE	4096		// adc max array size, decimated samples
+#define ADC_READ_BLOCK	16			// max samples per channel per scan
+#define ADC_MIN_SIZE	16			// smallest settable window
+#define ADC_SCAN_RATE	250			// default scans per second
+#define ADC_SCAN_RATE_MAX	1000	// scans per second limit
+#define ADC_JITTER_BUCKETS	16		// wakeup lateness histogram size
+
+typedef void (*adc_scan_cb)(void *user_data);	// called by sampler thread after each scan
+typedef void (*adc_sample_cb)(short value, void *user_data);	// called for each sample entering a window
+
+typedef struct __adc_window__ {		// averaging window, consumer side only
+	unsigned int reset;				// last ring reset seen
+	int bits;						// driver resolution of the raw samples
+	int npending;					// raw samples waiting for a full decimation block
+	short pending[ADC_DECIMATE];
+	int size_req;					// requested window length, 0: ADC_MAX_SIZE, any thread
+	int size;						// window length in use
+	int index;
+	int bsize;						// sensor_value buffer size (up to size)
+	long long sum;					// running sum of sensor_value[0..bsize)
+	unsigned long long sum_sq;		// running sum of squares of sensor_value[0..bsize)
+	adc_rank_t *rank;				// optional order statistics of the window
+	adc_sample_cb sample_cb;		// optional per sample filter
+	void *sample_data;
+	short sensor_value[ADC_MAX_SIZE];	// save adc buffer in round-robin method
+} adc_window_t;
+
+typedef struct __adc_channel__ {
+	adc_ring_t ring;				// raw samples, written by sampler thread
+	int err_count;					// failed scans in a row, sampler only
+	adc_window_t window;			// filled from ring by the channel consumer
+} adc_channel_t;
+
+typedef struct __adc_sched_stat__ {	// fixed rate sampler statistics
+	unsigned int rate_hz;			// scans per second
+	unsigned int ticks;				// deadlines served
+	unsigned int missed;			// deadlines skipped because the sampler was late
+	unsigned int max_late_us;		// worst wakeup lateness
+	unsigned int jitter[ADC_JITTER_BUCKETS];	// bucket n: lateness below 2^n usec, last bucket open
+} adc_sched_stat_t;
+
+
+void resource_adc_scan_set_channels(unsigned int mask);
+unsigned int resource_adc_scan_get_channels(void);
+adc_channel_t *resource_adc_scan_channel(int ch_num);
+
+void resource_adc_scan_set_rate(unsigned int rate_hz);
+unsigned int resource_adc_scan_get_rate(void);
+void resource_adc_scan_get_sched_stat(adc_sched_stat_t *stat);
+int resource_adc_scan_get_oversample(void);
+
+/* sampler thread */
+int resource_adc_scan_once(void);
+void resource_adc_scan_loop(int *done, adc_scan_cb scan_cb, void *user_data);
+
+/* one consumer per channel */
+void resource_adc_window_set_rank(int ch_num, adc_rank_t *rank);
+void resource_adc_window_set_sample_cb(int ch_num, adc_sample_cb sample_cb, void *user_data);
+int resource_adc_window_set_size(int ch_num, int size);
+int resource_adc_window_get_size(int ch_num);
+void resource_adc_window_drain(int ch_num);
+int resource_adc_window_stat(int ch_num, float *average, float *stddev);
+
+#endif /* _RESOURCE_ADC_SCAN_H_ */
@@ -0,0 +1,74 @@
+/*
+ * Copyright (c) 2018 Samsung Electronics Co., Ltd.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an AS IS BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef _RESOURCE_ADC_SPI_H_
+#define _RESOURCE_ADC_SPI_H_
+
+#define SPI_BUS_STDTA7D	0
+#define SPI_CS_STDTA7D	0
+
+#define ADC_SPI_FRAMES_MAX		64		// frames per resource_adc_spi_transfer_frames()
+
+#define ADC_SPI_TUNE_WINDOW		2048	// frames per error rate window
+#define ADC_SPI_TUNE_ERR_DEN	1000	// more than 1 / 1000 bad frames: clock down
+#define ADC_SPI_TUNE_RETRY		256		// clean windows before a failed clock is tried again
+
+#define ADC_SPI_LAT_SUB_BITS	3		// 8 sub buckets per power of 2, 12.5% resolution
+#define ADC_SPI_LAT_BUCKETS		((32 - ADC_SPI_LAT_SUB_BITS + 1) << ADC_SPI_LAT_SUB_BITS)	// up to 2^32 nsec
+
+typedef enum {
+	ADC_SPI_BACKEND_PERIPHERAL = 0,	// peripheral_io, one call per frame
+	ADC_SPI_BACKEND_SPIDEV,			// /dev/spidevB.C, one ioctl per block (-DADC_SPI_SPIDEV default)
+	ADC_SPI_BACKEND_MAX
+} adc_spi_backend_e;
+
+typedef struct __adc_spi_stat__ {	// spi clock tuner state
+	unsigned int speed_hz;			// current clock
+	unsigned int max_hz;			// fastest tuner step within the adc chip limit
+	int autotune;					// 1: clock follows the frame error rate
+	unsigned long long frames;		// frames decoded since open
+	unsigned long long bad_frames;	// frames failing the null bit check or transfer
+	unsigned int window_frames;		// frames in current window
+	unsigned int window_bad;		// bad frames in current window
+	unsigned int steps_up;
+	unsigned int steps_down;
+} adc_spi_stat_t;
+
+typedef struct __adc_spi_latency__ {	// bus call instrumentation, since start
+	unsigned long long calls;		// transfer calls (a spidev block is one call)
+	unsigned long long total_ns;
+	unsigned int max_ns;
+	unsigned int failed;			// transfer calls returning an error
+	unsigned int opens;				// device opens
+	unsigned int reopens;			// opens after the first one
+	unsigned int hist[ADC_SPI_LAT_BUCKETS];	// log bucketed call latency, see adc_spi_latency_bucket_ns()
+} adc_spi_latency_t;
+
+int resource_adc_spi_set_backend(adc_spi_backend_e backend);
+adc_spi_backend_e resource_adc_spi_get_backend(void);
+int resource_adc_spi_open(unsigned int speed_hz);
+int resource_adc_spi_transfer(unsigned char *tx, unsigned char *rx, int len);
+int resource_adc_spi_transfer_frames(unsigned char *tx, unsigned char *rx, int frame_len, int nframes);
+void resource_adc_spi_account(int good, int bad);
+void resource_adc_spi_set_autotune(int enable);
+void resource_adc_spi_get_stat(adc_spi_stat_t *stat);
+void resource_adc_spi_get_latency(adc_spi_latency_t *lat);
+unsigned int adc_spi_latency_bucket_ns(int bucket);
+unsigned int adc_spi_latency_percentile(const adc_spi_latency_t *lat, int percent);
+void resource_adc_spi_dump(void);
+void resource_adc_spi_close(void);
+
+#endif /* _RESOURCE_ADC_SPI_H_ */
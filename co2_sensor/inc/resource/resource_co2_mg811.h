@@ -0,0 +1,51 @@
+/*
+ * Copyright (c) 2018 Samsung Electronics Co., Ltd.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an AS IS BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef _RESOURCE_CO2_MG811_H_
+#define _RESOURCE_CO2_MG811_H_
+
+#define DEFAULT_ZERO_VOLTS	(2.950)
+#define DEFAULT_RANGE_VOLTS	(0.400)		// refer to datasheet
+
+#define ADC_MAX_VOLT		(4096.f)	// 12bit resolution
+#define ADC_REF_VOLT		(3300.f + 20.f)
+
+#define CO2_MG811_CODES		((int)ADC_MAX_VOLT + 1)	// adc codes 0 to 4096
+
+typedef struct sensor_mg811__ {
+	float zero_point_volts;		// refer to datasheet, start co2 valtage
+	float max_point_volts;		// refer to datasheet, max co2 voltage
+} sensor_mg811_t;
+
+/*
+ * adc code to ppm conversion of the mg811 sensor. -1 below 400 ppm,
+ * 10000 above the range. the float and the integer only (CO2_FIXED_POINT)
+ * versions are both built with CO2_MG811_BOTH for test/test_co2_mg811.c
+ */
+void resource_co2_mg811_init_float(int zero_mv);
+int resource_co2_mg811_ppm_float(int code);
+void resource_co2_mg811_init_fixed(int zero_mv);
+int resource_co2_mg811_ppm_fixed(int code);
+
+#if defined(CO2_FIXED_POINT)
+#define resource_co2_mg811_init		resource_co2_mg811_init_fixed
+#define resource_co2_mg811_ppm		resource_co2_mg811_ppm_fixed
+#else
+#define resource_co2_mg811_init		resource_co2_mg811_init_float
+#define resource_co2_mg811_ppm		resource_co2_mg811_ppm_float
+#endif
+
+#endif /* _RESOURCE_CO2_MG811_H_ */
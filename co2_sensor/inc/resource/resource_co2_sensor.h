@@ -18,25 +18,97 @@
 #define _RESOURCE_CO2_SENSOR_H_
 
 #include <pthread.h>
-
-extern pthread_mutex_t	mutex;
+#include "resource/resource_adc_scan.h"
+#include "resource/resource_p2_quantile.h"
 
 #define UNUSED(x)		(void)(x)	// unused argument
-#define MUTEX_LOCK		pthread_mutex_lock(&mutex)
-#define MUTEX_UNLOCK	pthread_mutex_unlock(&mutex)
-#define ADC_MAX_SIZE	1024		// adc max array size
-
-typedef struct __co2_sensor_data__ {	// common adc variable structure
-	int index;
-	int count;						// adc read count per one secound
-	int bsize;						// sensor_value buffer size (up to ADC_MAX_SIZE)
-	short sensor_value[ADC_MAX_SIZE];	// save adc buffer in round-robin method
-	float co2_sensor_average;			// co2 average value(ppm) per one secound
-} co2_sensor_data_t;
-
-typedef struct sensor_mg811__ {
-	float zero_point_volts;		// refer to datasheet, start co2 valtage
-	float max_point_volts;		// refer to datasheet, max co2 voltage
-} sensor_mg811_t;
+
+typedef enum {
+	CO2_ESTIMATOR_MEAN = 0,			// window average
+	CO2_ESTIMATOR_MEDIAN,			// window median
+	CO2_ESTIMATOR_TRIMMED,			// window average without lowest and highest CO2_TRIM_PERCENT
+	CO2_ESTIMATOR_KALMAN,			// 1-D kalman filter over every sample
+	CO2_ESTIMATOR_MAX
+} co2_estimator_e;
+
+#define CO2_TRIM_PERCENT	10
+#define CO2_KALMAN_Q		(1e-5f)		// default process noise, adc code^2 per sample
+#define CO2_KALMAN_R		(16.f)		// default measurement noise, adc code^2
+
+#define CO2_TREND_POINTS		30		// default trend window, points of 10 sec
+#define CO2_TREND_POINTS_MAX	360		// up to 1 hour
+
+#define CO2_PERCENTILES		3		// p50, p95, p99
+
+#define CO2_ADC_DRIVER_LEN	16		// adc chip name in co2_data
+
+#define NOTIFY_EVENT_WINDOW	0x01	// a full window of new samples is averaged
+#define NOTIFY_EVENT_ALARM	0x02	// co2 value needs to be sent now
+#define NOTIFY_EVENT_STEP	0x04	// step change detected in co2 value, the new level is sent
+#define NOTIFY_EVENT_CONFIG	0x08	// notify period changed, no value is sent
+
+typedef struct __co2_sensor_param__ {	// calibration, cached from co2_data file
+	int zero_volts;					// calibration min voltage (mV)
+	int max_volts;					// calibration max voltage (mV), not used
+	int notify_count;				// notify period in 10 msec units, 0: default
+	char adc_driver[CO2_ADC_DRIVER_LEN];	// adc chip name, "": build default
+	int spi_backend;				// adc_spi_backend_e, -1: build default
+	int window_size;				// averaging window in decimated samples, 0: ADC_MAX_SIZE
+	int scan_rate;					// adc scans per second, 0: ADC_SCAN_RATE
+	int estimator;					// co2_estimator_e, -1: CO2_ESTIMATOR_MEAN
+	int trend_window;				// trend window (sec), 0: CO2_TREND_POINTS points
+	float kalman_q;					// kalman process noise, 0: CO2_KALMAN_Q
+	float kalman_r;					// kalman measurement noise, 0: CO2_KALMAN_R
+} co2_sensor_param_t;
+
+typedef struct __co2_sensor_config__ {	// x.com.st.co2sensorconfig, set as a whole and kept in co2_data
+	int window_size;				// decimated samples, ADC_MIN_SIZE to ADC_MAX_SIZE
+	int scan_rate;					// scans per second, 1 to ADC_SCAN_RATE_MAX
+	co2_estimator_e estimator;
+	int notify_period;				// msec
+	char adc_driver[CO2_ADC_DRIVER_LEN];	// adc chip name
+	int spi_backend;				// adc_spi_backend_e
+	int trend_window;				// sec
+	float kalman_q;					// kalman process noise, > 0
+	float kalman_r;					// kalman measurement noise, > 0
+} co2_sensor_config_t;
+
+typedef struct __co2_sensor_snapshot__ {	// latest co2 value, published by aggregate thread
+	int ppm;						// co2 ppm, -1 if no valid data
+	float average;					// window average adc value
+	float stddev;					// window standard deviation
+	int samples;					// samples in window
+	float trend;					// co2 change, ppm per minute
+	float percentile[CO2_PERCENTILES];	// p50/p95/p99 block ppm of the last full minute, -1 before
+	unsigned long long timestamp;	// CLOCK_MONOTONIC msec when computed
+	unsigned int seq;				// increments on every publish
+} co2_sensor_snapshot_t;
+
+typedef struct __co2_sensor_diag__ {	// sampler health, refreshed every second by aggregate thread
+	float sample_rate;				// raw adc samples per second
+	float spi_error_rate;			// bad spi frames / frames
+	int window_fill;				// samples in window
+	int window_size;				// window length
+	float estimate_us;				// average time to drain and estimate one co2 value
+	unsigned int missed;			// sampler deadlines missed since start
+	unsigned long long last_notify;	// CLOCK_REALTIME msec of the last notify, 0: none yet
+} co2_sensor_diag_t;
+
+void resource_get_co2_sensor_snapshot(co2_sensor_snapshot_t *snap);
+void resource_get_co2_sensor_diag(co2_sensor_diag_t *diag);
+int resource_set_co2_sensor_estimator(co2_estimator_e estimator);
+co2_estimator_e resource_get_co2_sensor_estimator(void);
+int resource_set_co2_sensor_kalman(float process_noise, float measure_noise);
+void resource_get_co2_sensor_kalman(float *process_noise, float *measure_noise);
+int resource_set_co2_sensor_trend_window(int sec);
+int resource_get_co2_sensor_trend_window(void);
+int resource_get_co2_sensor_notify_period(void);
+const char *resource_get_co2_sensor_adc_driver(void);
+int resource_get_co2_sensor_spi_backend(void);
+int resource_get_co2_sensor_window(void);
+void resource_get_co2_sensor_config(co2_sensor_config_t *cfg);
+int resource_set_co2_sensor_config(const co2_sensor_config_t *cfg);
+void resource_co2_sensor_notify_event(unsigned int event);
+void resource_co2_sensor_wakeup(void);
 
 #endif /* _RESOURCE_CO2_SENSOR_H_ */
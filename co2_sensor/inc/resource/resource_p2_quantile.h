@@ -0,0 +1,34 @@
+/*
+ * Copyright (c) 2018 Samsung Electronics Co., Ltd.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an AS IS BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef _RESOURCE_P2_QUANTILE_H_
+#define _RESOURCE_P2_QUANTILE_H_
+
+#define P2_MARKERS	5
+
+typedef struct __p2_quantile__ {	// streaming p-quantile estimate in constant memory
+	float p;						// quantile, 0 ~ 1
+	int count;						// values seen
+	float height[P2_MARKERS];		// marker heights, height[2] is the estimate
+	int pos[P2_MARKERS];			// marker positions
+	float want[P2_MARKERS];			// desired marker positions
+} p2_quantile_t;
+
+void p2_quantile_init(p2_quantile_t *p2, float p);
+void p2_quantile_add(p2_quantile_t *p2, float x);
+float p2_quantile_get(p2_quantile_t *p2);
+
+#endif /* _RESOURCE_P2_QUANTILE_H_ */
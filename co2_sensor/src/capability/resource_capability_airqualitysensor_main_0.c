@@ -15,27 +15,49 @@
  */
 
 #include "smartthings_resource.h"
+#include "resource/resource_co2_sensor.h"
 #include "log.h"
 
 static const char *PROP_AIRQUALITY = "airQuality";
 static const char *PROP_RANGE = "range";
+static const char *PROP_TREND = "trend";
+static const char *PROP_PERCENTILES = "percentiles";
 static double g_range[2] = { 0, 10000. };
 static size_t g_length = 2;
 int32_t g_co2_sensor_value = 400;
 
-extern int resource_update_co2_sensor_value(void);
-
 bool handle_get_request_on_resource_capability_airqualitysensor_main_0(smartthings_payload_h resp_payload, void *user_data)
 {
 	int error = SMARTTHINGS_RESOURCE_ERROR_NONE;
+	co2_sensor_snapshot_t snap;
 
-	g_co2_sensor_value = resource_update_co2_sensor_value();
+	resource_get_co2_sensor_snapshot(&snap);
+	g_co2_sensor_value = snap.ppm;
 	error = smartthings_payload_set_int(resp_payload, PROP_AIRQUALITY, g_co2_sensor_value);
 	if (error != SMARTTHINGS_RESOURCE_ERROR_NONE) {
 		_E("smartthings_payload_set_int() failed, [%d]", error);
 		return false;
 	}
 
+	error = smartthings_payload_set_double(resp_payload, PROP_TREND, snap.trend);
+	if (error != SMARTTHINGS_RESOURCE_ERROR_NONE) {
+		_E("smartthings_payload_set_double() failed, [%d]", error);
+		return false;
+	}
+
+	if (snap.percentile[0] >= 0.f) {
+		double percentile[CO2_PERCENTILES];
+		int i;
+
+		for (i = 0; i < CO2_PERCENTILES; i++)
+			percentile[i] = snap.percentile[i];
+		error = smartthings_payload_set_double_array(resp_payload, PROP_PERCENTILES, percentile, CO2_PERCENTILES);
+		if (error != SMARTTHINGS_RESOURCE_ERROR_NONE) {
+			_E("smartthings_payload_set_double_array() failed, [%d]", error);
+			return false;
+		}
+	}
+
 	error = smartthings_payload_set_double_array(resp_payload, PROP_RANGE, (double*)&g_range, g_length);
 	if (error != SMARTTHINGS_RESOURCE_ERROR_NONE) {
 		_E("smartthings_payload_set_double_array() failed, [%d]", error);
@@ -0,0 +1,202 @@
+/*
+ * Copyright (c) 2018 Samsung Electronics Co., Ltd.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an AS IS BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "smartthings_resource.h"
+#include "resource/resource_co2_sensor.h"
+#include "resource/resource_adc_spi.h"
+#include "log.h"
+
+static const char* PROP_WINDOW = "windowSize";
+static const char* PROP_RATE = "sampleRate";
+static const char* PROP_ESTIMATOR = "estimator";
+static const char* PROP_NOTIFY = "notifyPeriod";
+static const char* PROP_KALMAN_Q = "kalmanProcessNoise";
+static const char* PROP_KALMAN_R = "kalmanMeasureNoise";
+static const char* PROP_TREND = "trendWindow";
+static const char* PROP_ADC_DRIVER = "adcDriver";
+static const char* PROP_SPI_BACKEND = "spiBackend";
+
+static const char *estimator_name[CO2_ESTIMATOR_MAX] = {
+	[CO2_ESTIMATOR_MEAN] = "mean",
+	[CO2_ESTIMATOR_MEDIAN] = "median",
+	[CO2_ESTIMATOR_TRIMMED] = "trimmed",
+	[CO2_ESTIMATOR_KALMAN] = "kalman",
+};
+
+static const char *spi_backend_name[ADC_SPI_BACKEND_MAX] = {
+	[ADC_SPI_BACKEND_PERIPHERAL] = "peripheral",
+	[ADC_SPI_BACKEND_SPIDEV] = "spidev",
+};
+
+/*
+ * index of str in names[], -1 if not found
+ */
+static int _find_name(const char *names[], int count, const char *str)
+{
+	int i;
+
+	for (i = 0; str && i < count; i++) {
+		if (!strcmp(str, names[i]))
+			return i;
+	}
+
+	return -1;
+}
+
+static bool _set_config_payload(smartthings_payload_h resp_payload)
+{
+	int error = SMARTTHINGS_RESOURCE_ERROR_NONE;
+	co2_sensor_config_t cfg;
+
+	resource_get_co2_sensor_config(&cfg);
+
+	error = smartthings_payload_set_int(resp_payload, PROP_WINDOW, cfg.window_size);
+	if (error != SMARTTHINGS_RESOURCE_ERROR_NONE) {
+		_E("smartthings_payload_set_int() failed, [%d]", error);
+		return false;
+	}
+
+	error = smartthings_payload_set_int(resp_payload, PROP_RATE, cfg.scan_rate);
+	if (error != SMARTTHINGS_RESOURCE_ERROR_NONE) {
+		_E("smartthings_payload_set_int() failed, [%d]", error);
+		return false;
+	}
+
+	error = smartthings_payload_set_string(resp_payload, PROP_ESTIMATOR, estimator_name[cfg.estimator]);
+	if (error != SMARTTHINGS_RESOURCE_ERROR_NONE) {
+		_E("smartthings_payload_set_string() failed, [%d]", error);
+		return false;
+	}
+
+	error = smartthings_payload_set_int(resp_payload, PROP_NOTIFY, cfg.notify_period);
+	if (error != SMARTTHINGS_RESOURCE_ERROR_NONE) {
+		_E("smartthings_payload_set_int() failed, [%d]", error);
+		return false;
+	}
+
+	error = smartthings_payload_set_string(resp_payload, PROP_ADC_DRIVER, cfg.adc_driver);
+	if (error != SMARTTHINGS_RESOURCE_ERROR_NONE) {
+		_E("smartthings_payload_set_string() failed, [%d]", error);
+		return false;
+	}
+
+	error = smartthings_payload_set_string(resp_payload, PROP_SPI_BACKEND, spi_backend_name[cfg.spi_backend]);
+	if (error != SMARTTHINGS_RESOURCE_ERROR_NONE) {
+		_E("smartthings_payload_set_string() failed, [%d]", error);
+		return false;
+	}
+
+	error = smartthings_payload_set_int(resp_payload, PROP_TREND, cfg.trend_window);
+	if (error != SMARTTHINGS_RESOURCE_ERROR_NONE) {
+		_E("smartthings_payload_set_int() failed, [%d]", error);
+		return false;
+	}
+
+	error = smartthings_payload_set_double(resp_payload, PROP_KALMAN_Q, cfg.kalman_q);
+	if (error != SMARTTHINGS_RESOURCE_ERROR_NONE) {
+		_E("smartthings_payload_set_double() failed, [%d]", error);
+		return false;
+	}
+
+	error = smartthings_payload_set_double(resp_payload, PROP_KALMAN_R, cfg.kalman_r);
+	if (error != SMARTTHINGS_RESOURCE_ERROR_NONE) {
+		_E("smartthings_payload_set_double() failed, [%d]", error);
+		return false;
+	}
+
+	return true;
+}
+
+bool handle_get_request_on_resource_capability_co2sensorconfig_main_0(smartthings_payload_h resp_payload, void *user_data)
+{
+	return _set_config_payload(resp_payload);
+}
+
+/*
+ * every property is optional. the request is merged into the values in use,
+ * checked as a whole and applied only if every value is valid, so a wrong
+ * property leaves all of them unchanged. all properties are kept in co2_data
+ * and restored on the next start. response carries the values in use
+ */
+bool handle_set_request_on_resource_capability_co2sensorconfig_main_0(smartthings_payload_h payload, smartthings_payload_h resp_payload, void *user_data)
+{
+	co2_sensor_config_t cfg;
+	int ivalue = 0;
+	double dvalue = 0;
+	char *str_value = NULL;
+	bool result = true;
+	int i;
+
+	resource_get_co2_sensor_config(&cfg);
+
+	if (smartthings_payload_get_int(payload, PROP_WINDOW, &ivalue) == SMARTTHINGS_RESOURCE_ERROR_NONE)
+		cfg.window_size = ivalue;
+
+	if (smartthings_payload_get_int(payload, PROP_RATE, &ivalue) == SMARTTHINGS_RESOURCE_ERROR_NONE)
+		cfg.scan_rate = ivalue;
+
+	if (smartthings_payload_get_string(payload, PROP_ESTIMATOR, &str_value) == SMARTTHINGS_RESOURCE_ERROR_NONE) {
+		i = _find_name(estimator_name, CO2_ESTIMATOR_MAX, str_value);
+		if (i < 0) {
+			_E("wrong %s: %s", PROP_ESTIMATOR, str_value ? str_value : "");
+			result = false;
+		} else
+			cfg.estimator = i;
+		free(str_value);
+	}
+
+	if (smartthings_payload_get_int(payload, PROP_NOTIFY, &ivalue) == SMARTTHINGS_RESOURCE_ERROR_NONE)
+		cfg.notify_period = ivalue;
+
+	if (smartthings_payload_get_string(payload, PROP_ADC_DRIVER, &str_value) == SMARTTHINGS_RESOURCE_ERROR_NONE) {
+		if (!str_value || strlen(str_value) >= sizeof(cfg.adc_driver)) {
+			_E("wrong %s: %s", PROP_ADC_DRIVER, str_value ? str_value : "");
+			result = false;
+		} else
+			snprintf(cfg.adc_driver, sizeof(cfg.adc_driver), "%s", str_value);
+		free(str_value);
+	}
+
+	if (smartthings_payload_get_string(payload, PROP_SPI_BACKEND, &str_value) == SMARTTHINGS_RESOURCE_ERROR_NONE) {
+		i = _find_name(spi_backend_name, ADC_SPI_BACKEND_MAX, str_value);
+		if (i < 0) {
+			_E("wrong %s: %s", PROP_SPI_BACKEND, str_value ? str_value : "");
+			result = false;
+		} else
+			cfg.spi_backend = i;
+		free(str_value);
+	}
+
+	if (smartthings_payload_get_int(payload, PROP_TREND, &ivalue) == SMARTTHINGS_RESOURCE_ERROR_NONE)
+		cfg.trend_window = ivalue;
+
+	if (smartthings_payload_get_double(payload, PROP_KALMAN_Q, &dvalue) == SMARTTHINGS_RESOURCE_ERROR_NONE)
+		cfg.kalman_q = dvalue;
+
+	if (smartthings_payload_get_double(payload, PROP_KALMAN_R, &dvalue) == SMARTTHINGS_RESOURCE_ERROR_NONE)
+		cfg.kalman_r = dvalue;
+
+	if (result && resource_set_co2_sensor_config(&cfg) < 0)
+		result = false;
+
+	if (!_set_config_payload(resp_payload))
+		return false;
+
+	return result;
+}
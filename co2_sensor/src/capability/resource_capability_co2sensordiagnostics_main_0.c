@@ -0,0 +1,76 @@
+/*
+ * Copyright (c) 2018 Samsung Electronics Co., Ltd.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an AS IS BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "smartthings_resource.h"
+#include "resource/resource_co2_sensor.h"
+#include "log.h"
+
+static const char* PROP_SAMPLE_RATE = "samplesPerSec";
+static const char* PROP_SPI_ERROR_RATE = "spiErrorRate";
+static const char* PROP_WINDOW_FILL = "windowFill";
+static const char* PROP_ESTIMATOR_LATENCY = "estimatorLatency";
+static const char* PROP_MISSED = "missedTicks";
+static const char* PROP_LAST_NOTIFY = "lastNotify";
+
+bool handle_get_request_on_resource_capability_co2sensordiagnostics_main_0(smartthings_payload_h resp_payload, void *user_data)
+{
+	int error = SMARTTHINGS_RESOURCE_ERROR_NONE;
+	co2_sensor_diag_t diag;
+
+	resource_get_co2_sensor_diag(&diag);
+
+	error = smartthings_payload_set_double(resp_payload, PROP_SAMPLE_RATE, diag.sample_rate);
+	if (error != SMARTTHINGS_RESOURCE_ERROR_NONE) {
+		_E("smartthings_payload_set_double() failed, [%d]", error);
+		return false;
+	}
+
+	error = smartthings_payload_set_double(resp_payload, PROP_SPI_ERROR_RATE, diag.spi_error_rate);
+	if (error != SMARTTHINGS_RESOURCE_ERROR_NONE) {
+		_E("smartthings_payload_set_double() failed, [%d]", error);
+		return false;
+	}
+
+	// percent of the window length
+	error = smartthings_payload_set_double(resp_payload, PROP_WINDOW_FILL,
+			diag.window_size ? 100. * diag.window_fill / diag.window_size : 0.);
+	if (error != SMARTTHINGS_RESOURCE_ERROR_NONE) {
+		_E("smartthings_payload_set_double() failed, [%d]", error);
+		return false;
+	}
+
+	// usec
+	error = smartthings_payload_set_double(resp_payload, PROP_ESTIMATOR_LATENCY, diag.estimate_us);
+	if (error != SMARTTHINGS_RESOURCE_ERROR_NONE) {
+		_E("smartthings_payload_set_double() failed, [%d]", error);
+		return false;
+	}
+
+	error = smartthings_payload_set_int(resp_payload, PROP_MISSED, (int)diag.missed);
+	if (error != SMARTTHINGS_RESOURCE_ERROR_NONE) {
+		_E("smartthings_payload_set_int() failed, [%d]", error);
+		return false;
+	}
+
+	// unix time in seconds, 0 before the first notify
+	error = smartthings_payload_set_double(resp_payload, PROP_LAST_NOTIFY, diag.last_notify / 1000.);
+	if (error != SMARTTHINGS_RESOURCE_ERROR_NONE) {
+		_E("smartthings_payload_set_double() failed, [%d]", error);
+		return false;
+	}
+
+	return true;
+}
@@ -26,6 +26,8 @@
 static const char *RES_CAPABILITY_SWITCH = "/capability/switch/main/0";
 static const char *RES_CAPABILITY_THERMOSTATCOOLINGSETPOINT = "/capability/thermostatCoolingSetpoint/main/0";
 static const char *RES_CAPABILITY_AIRQUALITYSENSOR = "/capability/airQualitySensor/main/0";
+static const char *RES_CAPABILITY_CO2SENSORCONFIG = "/capability/co2SensorConfig/main/0";
+static const char *RES_CAPABILITY_CO2SENSORDIAGNOSTICS = "/capability/co2SensorDiagnostics/main/0";
 
 smartthings_resource_h st_handle = NULL;
 static bool is_init = false;
@@ -34,8 +36,8 @@ static smartthings_h st_h;
 
 smartthings_status_e st_things_status = -1;
 
-pthread_mutex_t  mutex = PTHREAD_MUTEX_INITIALIZER;
 extern int thread_done; /* resource_co2_sensor.c */
+extern int spi_dump_request; /* resource_co2_sensor.c */
 
 /* get and set request handlers */
 extern bool handle_get_request_on_resource_capability_switch_main_0(smartthings_payload_h resp_payload, void *user_data);
@@ -43,8 +45,12 @@ extern bool handle_set_request_on_resource_capability_switch_main_0(smartthings_
 extern bool handle_get_request_on_resource_capability_airqualitysensor_main_0(smartthings_payload_h resp_payload, void *user_data);
 extern bool handle_get_request_on_resource_capability_thermostatcoolingsetpoint_main_0(smartthings_payload_h resp_payload, void *user_data);
 extern bool handle_set_request_on_resource_capability_thermostatcoolingsetpoint_main_0(smartthings_payload_h payload, smartthings_payload_h resp_payload, void *user_data);
+extern bool handle_get_request_on_resource_capability_co2sensorconfig_main_0(smartthings_payload_h resp_payload, void *user_data);
+extern bool handle_set_request_on_resource_capability_co2sensorconfig_main_0(smartthings_payload_h payload, smartthings_payload_h resp_payload, void *user_data);
+extern bool handle_get_request_on_resource_capability_co2sensordiagnostics_main_0(smartthings_payload_h resp_payload, void *user_data);
 
 extern void *thread_sensor_main(void *arg);
+extern void *thread_sensor_aggregate(void *arg);
 extern void *thread_sensor_notify(void *arg);
 
 void sig_handler(int sig)
@@ -62,6 +68,10 @@ void sig_handler(int sig)
 		_I("SIGTERM received");
 		thread_done = 1;
 		break;
+	case SIGUSR1:	// kill -USR1 <pid> logs the adc spi statistics
+		_I("SIGUSR1 received");
+		__atomic_store_n(&spi_dump_request, 1, __ATOMIC_RELAXED);
+		break;
 	default:
 		_E("wasn't expecting that sig [%d]", sig);
 		abort();
@@ -71,21 +81,25 @@ void sig_handler(int sig)
 /* main loop */
 void handle_main_loop(void)
 {
-	pthread_t p_thread[2];
+	pthread_t p_thread[3];
 	int ret = 0;
 
 	signal(SIGSEGV, sig_handler);
 	signal(SIGINT, sig_handler);
 	signal(SIGTERM, sig_handler);
-
-	pthread_mutex_init(&mutex, NULL);
+	signal(SIGUSR1, sig_handler);
 
 	ret = pthread_create(&p_thread[0], NULL, &thread_sensor_main, NULL);
 	if (ret != 0) {
 		_E("[ERROR] thread_sensor_main create failed, ret=%d", ret);
 		return;
 	}
-	ret = pthread_create(&p_thread[1], NULL, &thread_sensor_notify, NULL);
+	ret = pthread_create(&p_thread[1], NULL, &thread_sensor_aggregate, NULL);
+	if (ret != 0) {
+		_E("[ERROR] thread_sensor_aggregate create failed, ret=%d", ret);
+		return;
+	}
+	ret = pthread_create(&p_thread[2], NULL, &thread_sensor_notify, NULL);
 	if (ret != 0) {
 		_E("[ERROR] thread_sensor_notify create failed, ret=%d", ret);
 		return;
@@ -127,6 +141,12 @@ void _request_cb(smartthings_resource_h st_h, int req_id, const char *uri, smart
 		if (0 == strncmp(uri, RES_CAPABILITY_THERMOSTATCOOLINGSETPOINT, strlen(RES_CAPABILITY_THERMOSTATCOOLINGSETPOINT))) {
 			result = handle_get_request_on_resource_capability_thermostatcoolingsetpoint_main_0(resp_payload, user_data);
 		}
+		if (0 == strncmp(uri, RES_CAPABILITY_CO2SENSORCONFIG, strlen(RES_CAPABILITY_CO2SENSORCONFIG))) {
+			result = handle_get_request_on_resource_capability_co2sensorconfig_main_0(resp_payload, user_data);
+		}
+		if (0 == strncmp(uri, RES_CAPABILITY_CO2SENSORDIAGNOSTICS, strlen(RES_CAPABILITY_CO2SENSORDIAGNOSTICS))) {
+			result = handle_get_request_on_resource_capability_co2sensordiagnostics_main_0(resp_payload, user_data);
+		}
 	} else if (req_type == SMARTTHINGS_RESOURCE_REQUEST_SET) {
 		if (0 == strncmp(uri, RES_CAPABILITY_SWITCH, strlen(RES_CAPABILITY_SWITCH))) {
 			result = handle_set_request_on_resource_capability_switch_main_0(payload, resp_payload, user_data);
@@ -134,6 +154,9 @@ void _request_cb(smartthings_resource_h st_h, int req_id, const char *uri, smart
 		if (0 == strncmp(uri, RES_CAPABILITY_THERMOSTATCOOLINGSETPOINT, strlen(RES_CAPABILITY_THERMOSTATCOOLINGSETPOINT))) {
 			result = handle_set_request_on_resource_capability_thermostatcoolingsetpoint_main_0(payload, resp_payload, user_data);
 		}
+		if (0 == strncmp(uri, RES_CAPABILITY_CO2SENSORCONFIG, strlen(RES_CAPABILITY_CO2SENSORCONFIG))) {
+			result = handle_set_request_on_resource_capability_co2sensorconfig_main_0(payload, resp_payload, user_data);
+		}
 	} else {
 		_E("Invalid request type");
 		smartthings_payload_destroy(resp_payload);
@@ -433,12 +456,9 @@ static bool service_app_create(void *user_data)
 
 static void service_app_terminate(void *user_data)
 {
-	MUTEX_LOCK;
-	thread_done = 1;
-	MUTEX_UNLOCK;
-
-	int status = pthread_mutex_destroy(&mutex);
-    _I("mutex destroy status = %d", status);
+	__atomic_store_n(&thread_done, 1, __ATOMIC_RELEASE);
+	resource_co2_sensor_wakeup();	// let waiting threads see thread_done
+	_I("sensor threads stopping");
 }
 
 static void service_app_control(app_control_h app_control, void *user_data)
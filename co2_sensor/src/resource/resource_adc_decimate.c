@@ -0,0 +1,110 @@
+/*
+ * Copyright (c) 2018 Samsung Electronics Co., Ltd.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an AS IS BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#if defined(__ARM_NEON) || defined(__ARM_NEON__)
+#include <arm_neon.h>
+#elif defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+#include "resource/resource_adc_decimate.h"
+
+/*
+ * first order cic (sum and dump) decimator: 4^(12 - bits) raw samples sum
+ * to a (24 - bits) bit value, the extra bits are noise and shifted out -> 12bit.
+ * e.g. 16 raw 10bit samples sum to 14bit, out = sum >> 2; a 12bit adc needs
+ * no oversampling at all.
+ * SPI_REF_VOLT / SPI_MAX_VOLT (3000 / 3200 = 15 / 16) calibration is applied
+ * in the same step, out = sum * 15 >> (12 - bits + 4)
+ */
+#define DECIMATE_CAL_MUL	15
+#define DECIMATE_CAL_SHIFT	4
+
+#if ADC_DECIMATE != 16 && (defined(__ARM_NEON) || defined(__ARM_NEON__) || defined(__SSE2__))
+#error "simd block sum handles 16 samples per block"
+#endif
+
+#if defined(__ARM_NEON) || defined(__ARM_NEON__)
+static inline int _block_sum(const short *in)
+{
+	int32x4_t acc;
+	int32x2_t sum;
+
+	acc = vpaddlq_s16(vld1q_s16(in));
+	acc = vpadalq_s16(acc, vld1q_s16(in + 8));
+	sum = vadd_s32(vget_low_s32(acc), vget_high_s32(acc));
+	sum = vpadd_s32(sum, sum);
+
+	return vget_lane_s32(sum, 0);
+}
+#elif defined(__SSE2__)
+static inline int _block_sum(const short *in)
+{
+	const __m128i ones = _mm_set1_epi16(1);
+	__m128i acc;
+
+	acc = _mm_add_epi32(_mm_madd_epi16(_mm_loadu_si128((const __m128i *)in), ones),
+			_mm_madd_epi16(_mm_loadu_si128((const __m128i *)(in + 8)), ones));
+	acc = _mm_add_epi32(acc, _mm_shuffle_epi32(acc, _MM_SHUFFLE(1, 0, 3, 2)));
+	acc = _mm_add_epi32(acc, _mm_shuffle_epi32(acc, _MM_SHUFFLE(2, 3, 0, 1)));
+
+	return _mm_cvtsi128_si32(acc);
+}
+#else
+static inline int _block_sum(const short *in)
+{
+	int i, sum = 0;
+
+	for (i = 0; i < ADC_DECIMATE; i++)
+		sum += in[i];
+
+	return sum;
+}
+#endif
+
+/*
+ * raw samples per decimated sample for a bits resolution adc (1 ~ ADC_DECIMATE)
+ */
+int adc_decimate_factor(int bits)
+{
+	if (bits >= ADC_OUTPUT_BITS)
+		return 1;
+	if (bits < ADC_OUTPUT_BITS - 2)
+		bits = ADC_OUTPUT_BITS - 2;
+
+	return 1 << (2 * (ADC_OUTPUT_BITS - bits));
+}
+
+/*
+ * decimate nblocks * adc_decimate_factor(bits) raw samples from in to nblocks samples in out
+ */
+void adc_decimate(const short *in, int nblocks, int bits, short *out)
+{
+	int factor = adc_decimate_factor(bits);
+	int shift = __builtin_ctz(factor) / 2 + DECIMATE_CAL_SHIFT;	// one extra bit per 4x
+	int b, i, sum;
+
+	if (factor == ADC_DECIMATE) {
+		for (b = 0; b < nblocks; b++, in += ADC_DECIMATE)
+			out[b] = (short)((_block_sum(in) * DECIMATE_CAL_MUL) >> shift);
+		return;
+	}
+
+	for (b = 0; b < nblocks; b++, in += factor) {
+		for (i = 0, sum = 0; i < factor; i++)
+			sum += in[i];
+		out[b] = (short)((sum * DECIMATE_CAL_MUL) >> shift);
+	}
+}
@@ -0,0 +1,166 @@
+/*
+ * Copyright (c) 2018 Samsung Electronics Co., Ltd.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an AS IS BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <string.h>
+#include "resource/resource_adc.h"
+#include "resource/resource_adc_spi.h"
+#include "log.h"
+
+#define ADC_BAD_FRAME_LOG	100			// log every 100th bad frame
+
+#define retv_if(expr, val) do { \
+	if (expr) { \
+		_E("(%s) -> %s() return", #expr, __FUNCTION__); \
+		return (val); \
+	} \
+} while (0)
+
+static const adc_driver_t *adc_drivers[] = {
+	&adc_driver_mcp3008,
+	&adc_driver_mcp3208,
+};
+
+#if defined(ADC_DRIVER_MCP3208)
+static const adc_driver_t *adc_driver = &adc_driver_mcp3208;
+#else
+static const adc_driver_t *adc_driver = &adc_driver_mcp3008;
+#endif
+
+static int spi_read_cnt = 0;		// frames decoded, samplers may share the adc
+static int spi_err_cnt = 0;		// bad frames
+
+/*
+ * adc chip by name, NULL if unknown
+ */
+const adc_driver_t *resource_adc_find_driver(const char *name)
+{
+	unsigned int i;
+
+	if (!name)
+		return NULL;
+
+	for (i = 0; i < sizeof(adc_drivers) / sizeof(adc_drivers[0]); i++) {
+		if (!strcmp(adc_drivers[i]->name, name))
+			return adc_drivers[i];
+	}
+
+	return NULL;
+}
+
+/*
+ * select adc chip by name, from the sampler thread while no driver is initialized
+ */
+int resource_adc_set_driver(const char *name)
+{
+	const adc_driver_t *driver = resource_adc_find_driver(name);
+
+	if (!driver) {
+		_E("unknown adc driver: %s", name ? name : "");
+		return -1;
+	}
+	__atomic_store_n(&adc_driver, driver, __ATOMIC_RELEASE);
+	_D("adc driver: %s, %d bit", name, driver->bits);
+
+	return 0;
+}
+
+const adc_driver_t *resource_adc_get_driver(void)
+{
+	return __atomic_load_n(&adc_driver, __ATOMIC_ACQUIRE);
+}
+
+int resource_adc_driver_init(const adc_driver_t *driver)
+{
+	retv_if(driver == NULL, -1);
+	retv_if((driver->frame_len <= 0 || driver->frame_len > ADC_FRAME_LEN_MAX), -1);
+
+	return resource_adc_spi_open(driver->speed_hz);
+}
+
+/*
+ * check and decode one conversion frame
+ */
+static int _adc_driver_decode(const adc_driver_t *driver, const unsigned char *rx, unsigned int *out_value)
+{
+	int read_cnt;
+
+	read_cnt = __atomic_add_fetch(&spi_read_cnt, 1, __ATOMIC_RELAXED);
+	if (driver->decode(rx, out_value) < 0) {
+		if (__atomic_add_fetch(&spi_err_cnt, 1, __ATOMIC_RELAXED) % ADC_BAD_FRAME_LOG == 0)
+			_D("%s bad frame -> rx: %02x %02x, count: %d", driver->name, rx[0], rx[1], read_cnt);
+		return -1;
+	}
+
+	return 0;
+}
+
+int resource_adc_driver_read(const adc_driver_t *driver, int ch_num, unsigned int *out_value)
+{
+	unsigned char rx[ADC_FRAME_LEN_MAX] = {0, };
+	unsigned char tx[ADC_FRAME_LEN_MAX] = {0, };
+	int ret;
+
+	retv_if(driver == NULL, -1);
+	retv_if(out_value == NULL, -1);
+	retv_if((ch_num < 0 || ch_num >= driver->channels), -1);
+
+	driver->encode(ch_num, tx);
+	retv_if(resource_adc_spi_transfer(tx, rx, driver->frame_len) < 0, -1);
+
+	ret = _adc_driver_decode(driver, rx, out_value);
+	resource_adc_spi_account(ret == 0, ret != 0);
+
+	return ret;
+}
+
+/*
+ * read up to n conversions of one channel, returns the number of valid
+ * samples stored to out_value[], bad frames are dropped.
+ */
+int resource_adc_driver_read_block(const adc_driver_t *driver, int ch_num, unsigned int out_value[], int n)
+{
+	unsigned char rx[ADC_FRAME_LEN_MAX * ADC_SPI_FRAMES_MAX];
+	unsigned char tx[ADC_FRAME_LEN_MAX * ADC_SPI_FRAMES_MAX];
+	int len;
+	int i, count = 0;
+
+	retv_if(driver == NULL, -1);
+	retv_if(out_value == NULL, -1);
+	retv_if((ch_num < 0 || ch_num >= driver->channels), -1);
+	retv_if((n <= 0 || n > ADC_SPI_FRAMES_MAX), -1);
+
+	len = driver->frame_len;
+	for (i = 0; i < n; i++)
+		driver->encode(ch_num, tx + i * len);
+
+	// MCP3x08 starts a new conversion only after CS goes high, so every
+	// frame is its own transfer; failed frames read 0xFF and fail the null bit check
+	resource_adc_spi_transfer_frames(tx, rx, len, n);
+
+	for (i = 0; i < n; i++) {
+		if (_adc_driver_decode(driver, rx + i * len, &out_value[count]) == 0)
+			count++;
+	}
+
+	resource_adc_spi_account(count, n - count);
+
+	return count;
+}
+
+void resource_adc_driver_fini(const adc_driver_t *driver)
+{
+	resource_adc_spi_close();
+}
@@ -19,14 +19,11 @@
  * limitations under the License.
  */
 
-#include <stdlib.h>
-#include <peripheral_io.h>
-#include <system_info.h>
-#include "resource/resource_co2_sensor.h"
-#include "log.h"
+#include "resource/resource_adc.h"
 
 #define	MCP3008_SPEED 3600000
-#define MCP3008_BPW 8
+#define MCP3008_BITS 10
+#define MCP3008_CHANNELS 8
 
 #define	MCP3008_TX_WORD1     0x01	/* 0b00000001 */
 #define	MCP3008_TX_CH0 0x80	/* 0b10000000 */
@@ -45,166 +42,49 @@
 #define MCP3008_RX_WORD3_MASK 0xFF	/* 0b11111111 */
 #define UINT10_VALIDATION_MASK 0x3FF
 
-#define SPI_BUS_STDTA7D	0
-#define SPI_CS_STDTA7D	0
+#define MCP3008_FRAME_LEN 3		/* bytes per conversion */
 
-static peripheral_spi_h MCP3008_H = NULL;
-static unsigned int ref_count = 0;
+static const unsigned char mcp3008_tx_channel[MCP3008_CHANNELS] = {	/* second tx word per channel */
+	MCP3008_TX_CH0, MCP3008_TX_CH1, MCP3008_TX_CH2, MCP3008_TX_CH3,
+	MCP3008_TX_CH4, MCP3008_TX_CH5, MCP3008_TX_CH6, MCP3008_TX_CH7,
+};
 
-#define retv_if(expr, val) do { \
-	if (expr) { \
-		_E("(%s) -> %s() return", #expr, __FUNCTION__); \
-		return (val); \
-	} \
-} while (0)
-
-int resource_adc_mcp3008_init(void)
+static void _mcp3008_encode(int ch_num, unsigned char *tx)
 {
-	int ret = 0;
-	int bus = SPI_BUS_STDTA7D;
-	int chip_select = SPI_CS_STDTA7D;
-
-	if (MCP3008_H) {
-		_D("SPI device already initialized [ref_count : %u]", ref_count);
-		MUTEX_LOCK;
-		ref_count++;
-		MUTEX_UNLOCK;
-		return 0;
-	}
-
-	ret = peripheral_spi_open(bus, chip_select, &MCP3008_H);
-	if (PERIPHERAL_ERROR_NONE != ret) {
-		_E("spi open failed :%s ", get_error_message(ret));
-		return -1;
-	}
-
-	ret = peripheral_spi_set_mode(MCP3008_H, PERIPHERAL_SPI_MODE_0);
-	if (PERIPHERAL_ERROR_NONE != ret) {
-		_E("peripheral_spi_set_mode failed :%s ", get_error_message(ret));
-		goto error_after_open;
-	}
-	ret = peripheral_spi_set_bit_order(MCP3008_H, PERIPHERAL_SPI_BIT_ORDER_MSB);
-	if (PERIPHERAL_ERROR_NONE != ret) {
-		_E("peripheral_spi_set_bit_order failed :%s ", get_error_message(ret));
-		goto error_after_open;
-	}
-
-	ret = peripheral_spi_set_bits_per_word(MCP3008_H, MCP3008_BPW);
-	if (PERIPHERAL_ERROR_NONE != ret) {
-		_E("peripheral_spi_set_bits_per_word failed :%s ", get_error_message(ret));
-		goto error_after_open;
-	}
-
-	ret = peripheral_spi_set_frequency(MCP3008_H, MCP3008_SPEED);
-	if (PERIPHERAL_ERROR_NONE != ret) {
-		_E("peripheral_spi_set_frequency failed :%s ", get_error_message(ret));
-		goto error_after_open;
-	}
-	_D("%s success: %d", __func__, ref_count);
-
-	MUTEX_LOCK;
-	ref_count++;
-	MUTEX_UNLOCK;
-
-	return 0;
-
-error_after_open:
-	_D("%s error: %d", __func__, ref_count);
-	peripheral_spi_close(MCP3008_H);
-	MCP3008_H = NULL;
-	return -1;
+	tx[0] = MCP3008_TX_WORD1;
+	tx[1] = mcp3008_tx_channel[ch_num];
+	tx[2] = MCP3008_TX_WORD3;
 }
 
-int resource_read_adc_mcp3008(int ch_num, unsigned int *out_value)
+/*
+ * check and decode one 3 byte conversion frame
+ */
+static int _mcp3008_decode(const unsigned char *rx, unsigned int *out_value)
 {
-	static int spi_read_cnt = 0;
-	static int spi_err_cnt = 0;
-	unsigned char rx[3] = {0, };
-	unsigned char tx[3] = {0, };
 	unsigned char rx_w1 = 0;
 	unsigned char rx_w2 = 0;
 	unsigned char rx_w2_nb = 0;
 	unsigned char rx_w3 = 0;
-	unsigned short int result = 0;
-
-	retv_if(MCP3008_H == NULL, -1);
-	retv_if(out_value == NULL, -1);
-	retv_if((ch_num < 0 || ch_num > 7), -1);
-
-	tx[0] = MCP3008_TX_WORD1;
-	switch (ch_num) {
-	case 0:
-		tx[1] = MCP3008_TX_CH0;
-		break;
-	case 1:
-		tx[1] = MCP3008_TX_CH1;
-		break;
-	case 2:
-		tx[1] = MCP3008_TX_CH2;
-		break;
-	case 3:
-		tx[1] = MCP3008_TX_CH3;
-		break;
-	case 4:
-		tx[1] = MCP3008_TX_CH4;
-		break;
-	case 5:
-		tx[1] = MCP3008_TX_CH5;
-		break;
-	case 6:
-		tx[1] = MCP3008_TX_CH6;
-		break;
-	case 7:
-		tx[1] = MCP3008_TX_CH7;
-		break;
-	default:
-		tx[1] = MCP3008_TX_CH0;
-		break;
-	}
-	tx[2] = MCP3008_TX_WORD3;
-
-	peripheral_spi_transfer(MCP3008_H, tx, rx, 3);
 
 	rx_w1 = rx[0] & MCP3008_RX_WORD1_MASK;
 	rx_w2_nb = rx[1] & MCP3008_RX_WORD2_NULL_BIT_MASK;
-
-	// retv_if(rx_w1 != 0, -1);
-	// retv_if(rx_w2_nb != 0, -1);
-	spi_read_cnt += 1;
 	if (rx_w1 != 0 || rx_w2_nb != 0)
-	{
-		spi_err_cnt++;
-		if (spi_err_cnt >= 100)
-		{
-			_D("resource_read_adc_mcp3008 rx_w2_nb is not 0 -> rx: %02x, count: %d", rx[1], spi_read_cnt);
-			spi_err_cnt = 0;
-		}
 		return -1;
-	}
 
 	rx_w2 = rx[1] & MCP3008_RX_WORD2_MASK;
 	rx_w3 = rx[2] & MCP3008_RX_WORD3_MASK;
 
-	result = ((rx_w2 << 8) | (rx_w3)) & UINT10_VALIDATION_MASK;
-
-	*out_value = result;
+	*out_value = ((rx_w2 << 8) | (rx_w3)) & UINT10_VALIDATION_MASK;
 
 	return 0;
 }
 
-void resource_adc_mcp3008_fini(void)
-{
-	if (MCP3008_H) {
-		MUTEX_LOCK;
-		ref_count--;
-		MUTEX_UNLOCK;
-	}
-	else
-		return;
-
-	if (ref_count == 0) {
-		peripheral_spi_close(MCP3008_H);
-		MCP3008_H = NULL;
-	}
-}
-
+const adc_driver_t adc_driver_mcp3008 = {
+	.name = "mcp3008",
+	.bits = MCP3008_BITS,
+	.channels = MCP3008_CHANNELS,
+	.speed_hz = MCP3008_SPEED,
+	.frame_len = MCP3008_FRAME_LEN,
+	.encode = _mcp3008_encode,
+	.decode = _mcp3008_decode,
+};
@@ -0,0 +1,73 @@
+/*
+ * Copyright (c) 2018 Samsung Electronics Co., Ltd.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an AS IS BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "resource/resource_adc.h"
+
+#define	MCP3208_SPEED 2000000	/* limit at 5V, the bus runs at the 1.8MHz tuner step below it */
+#define MCP3208_BITS 12
+#define MCP3208_CHANNELS 8
+
+#define	MCP3208_TX_WORD1     0x06	/* 0b00000110, start bit + single ended, D2 in bit 0 */
+#define	MCP3208_TX_WORD2_SHIFT 6	/* D1 D0 in bit 7, 6 */
+#define	MCP3208_TX_WORD3     0x00	/* 0b00000000 */
+
+#define MCP3208_RX_WORD1_MASK 0x00	/* 0b00000000 */
+#define MCP3208_RX_WORD2_NULL_BIT_MASK 0x10	/* 0b00010000 */
+#define MCP3208_RX_WORD2_MASK 0x0F	/* 0b00001111 */
+#define MCP3208_RX_WORD3_MASK 0xFF	/* 0b11111111 */
+#define UINT12_VALIDATION_MASK 0xFFF
+
+#define MCP3208_FRAME_LEN 3		/* bytes per conversion */
+
+static void _mcp3208_encode(int ch_num, unsigned char *tx)
+{
+	tx[0] = MCP3208_TX_WORD1 | (ch_num >> 2);
+	tx[1] = (ch_num & 0x03) << MCP3208_TX_WORD2_SHIFT;
+	tx[2] = MCP3208_TX_WORD3;
+}
+
+/*
+ * check and decode one 3 byte conversion frame
+ */
+static int _mcp3208_decode(const unsigned char *rx, unsigned int *out_value)
+{
+	unsigned char rx_w1 = 0;
+	unsigned char rx_w2 = 0;
+	unsigned char rx_w2_nb = 0;
+	unsigned char rx_w3 = 0;
+
+	rx_w1 = rx[0] & MCP3208_RX_WORD1_MASK;
+	rx_w2_nb = rx[1] & MCP3208_RX_WORD2_NULL_BIT_MASK;
+	if (rx_w1 != 0 || rx_w2_nb != 0)
+		return -1;
+
+	rx_w2 = rx[1] & MCP3208_RX_WORD2_MASK;
+	rx_w3 = rx[2] & MCP3208_RX_WORD3_MASK;
+
+	*out_value = ((rx_w2 << 8) | (rx_w3)) & UINT12_VALIDATION_MASK;
+
+	return 0;
+}
+
+const adc_driver_t adc_driver_mcp3208 = {
+	.name = "mcp3208",
+	.bits = MCP3208_BITS,
+	.channels = MCP3208_CHANNELS,
+	.speed_hz = MCP3208_SPEED,
+	.frame_len = MCP3208_FRAME_LEN,
+	.encode = _mcp3208_encode,
+	.decode = _mcp3208_decode,
+};
@@ -0,0 +1,102 @@
+/*
+ * Copyright (c) 2018 Samsung Electronics Co., Ltd.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an AS IS BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <string.h>
+#include "resource/resource_adc_rank.h"
+
+/*
+ * adc samples are small integers, so the sliding window order statistics
+ * are kept as a value histogram in fenwick trees: add, remove, k-th value
+ * and sum of the k smallest values are all O(log ADC_RANK_SIZE).
+ */
+
+void adc_rank_reset(adc_rank_t *rank)
+{
+	memset(rank, 0, sizeof(*rank));
+}
+
+/*
+ * add (delta 1) or remove (delta -1) one sample
+ */
+void adc_rank_update(adc_rank_t *rank, int value, int delta)
+{
+	int i;
+
+	if (value < 0)
+		value = 0;
+	else if (value >= ADC_RANK_SIZE)
+		value = ADC_RANK_SIZE - 1;
+
+	rank->total += delta;
+	for (i = value + 1; i <= ADC_RANK_SIZE; i += i & (-i)) {
+		rank->count[i] += delta;
+		rank->sum[i] += delta * value;
+	}
+}
+
+/*
+ * find the largest value v with fewer than k samples below v.
+ * *below and *below_sum get count and sum of those samples
+ */
+static int _rank_descend(adc_rank_t *rank, int k, int *below, long long *below_sum)
+{
+	int pos = 0;
+	int step;
+
+	*below = 0;
+	*below_sum = 0;
+	for (step = ADC_RANK_SIZE; step > 0; step >>= 1) {
+		if (pos + step <= ADC_RANK_SIZE && *below + rank->count[pos + step] < k) {
+			pos += step;
+			*below += rank->count[pos];
+			*below_sum += rank->sum[pos];
+		}
+	}
+
+	return pos;		// fenwick index pos + 1 holds value pos
+}
+
+/*
+ * value of the k-th smallest sample, k from 0
+ */
+int adc_rank_select(adc_rank_t *rank, int k)
+{
+	int below;
+	long long below_sum;
+
+	if (k < 0 || k >= rank->total)
+		return -1;
+
+	return _rank_descend(rank, k + 1, &below, &below_sum);
+}
+
+/*
+ * sum of the k smallest samples
+ */
+long long adc_rank_sum_smallest(adc_rank_t *rank, int k)
+{
+	int below, value;
+	long long below_sum;
+
+	if (k <= 0)
+		return 0;
+	if (k > rank->total)
+		k = rank->total;
+
+	value = _rank_descend(rank, k, &below, &below_sum);
+
+	return below_sum + (long long)(k - below) * value;
+}
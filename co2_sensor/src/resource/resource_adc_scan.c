@@ -0,0 +1,344 @@
+/*
+ * Copyright (c) 2018 Samsung Electronics Co., Ltd.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an AS IS BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <stdbool.h>
+#include <math.h>
+#include <string.h>
+#include <errno.h>
+#include <time.h>
+#include "resource/resource_adc.h"
+#include "resource/resource_adc_scan.h"
+#include "log.h"
+
+#define SCAN_ERROR_RESET	100			// failed scans before a channel window is dropped
+#define NSEC_PER_SEC		1000000000ULL
+
+static adc_channel_t adc_channel[ADC_CHANNEL_MAX];
+static unsigned int scan_mask = 0;		// bit n: channel n is scanned
+static unsigned int scan_rate = ADC_SCAN_RATE;
+static adc_sched_stat_t sched_stat;		// written by sampler thread only
+
+/*
+ * raw samples read per decimated window sample with the current driver
+ */
+int resource_adc_scan_get_oversample(void)
+{
+	return adc_decimate_factor(resource_adc_get_driver()->bits);
+}
+
+void resource_adc_scan_set_channels(unsigned int mask)
+{
+	__atomic_store_n(&scan_mask, mask & ((1 << ADC_CHANNEL_MAX) - 1), __ATOMIC_RELAXED);
+	_D("adc scan channels: 0x%02x", mask);
+}
+
+unsigned int resource_adc_scan_get_channels(void)
+{
+	return __atomic_load_n(&scan_mask, __ATOMIC_RELAXED);
+}
+
+void resource_adc_scan_set_rate(unsigned int rate_hz)
+{
+	if (rate_hz == 0)
+		rate_hz = ADC_SCAN_RATE;
+	else if (rate_hz > ADC_SCAN_RATE_MAX)
+		rate_hz = ADC_SCAN_RATE_MAX;
+	__atomic_store_n(&scan_rate, rate_hz, __ATOMIC_RELAXED);
+	_D("adc scan rate: %u Hz", rate_hz);
+}
+
+unsigned int resource_adc_scan_get_rate(void)
+{
+	return __atomic_load_n(&scan_rate, __ATOMIC_RELAXED);
+}
+
+/*
+ * copy of the sampler statistics, counters may be one tick apart
+ */
+void resource_adc_scan_get_sched_stat(adc_sched_stat_t *stat)
+{
+	if (stat)
+		memcpy(stat, &sched_stat, sizeof(*stat));
+}
+
+adc_channel_t *resource_adc_scan_channel(int ch_num)
+{
+	if (ch_num < 0 || ch_num >= ADC_CHANNEL_MAX)
+		return NULL;
+
+	return &adc_channel[ch_num];
+}
+
+/*
+ * read one block from every enabled channel into its ring, sized for
+ * ADC_READ_BLOCK / ADC_DECIMATE window samples at the driver resolution.
+ * returns number of valid samples, -1 if no channel could be read
+ */
+int resource_adc_scan_once(void)
+{
+	const adc_driver_t *driver = resource_adc_get_driver();
+	unsigned int mask = resource_adc_scan_get_channels();
+	unsigned int out_value[ADC_READ_BLOCK];
+	int nread = ADC_READ_BLOCK / ADC_DECIMATE * adc_decimate_factor(driver->bits);
+	int ch, i, ret;
+	int total = -1;
+
+	for (ch = 0; ch < ADC_CHANNEL_MAX; ch++) {
+		adc_channel_t *chp = &adc_channel[ch];
+
+		if (!(mask & (1 << ch)) || ch >= driver->channels)
+			continue;
+
+		ret = resource_adc_driver_read_block(driver, ch, out_value, nread);
+		if (ret <= 0) {
+			if (++chp->err_count >= SCAN_ERROR_RESET) {
+				adc_ring_reset(&chp->ring);
+				chp->err_count = 0;
+			}
+			continue;
+		}
+
+		for (i = 0; i < ret; i++)
+			adc_ring_push(&chp->ring, (short)out_value[i]);
+		chp->err_count = 0;
+		total = (total < 0) ? ret : total + ret;
+	}
+
+	return total;
+}
+
+static void _window_clear(adc_window_t *win)
+{
+	win->npending = 0;
+	win->index = 0;
+	win->bsize = 0;
+	win->sum = 0;
+	win->sum_sq = 0;
+	if (win->rank)
+		adc_rank_reset(win->rank);
+}
+
+/*
+ * keep order statistics of the window in rank (NULL: none), consumer only
+ */
+void resource_adc_window_set_rank(int ch_num, adc_rank_t *rank)
+{
+	adc_channel_t *chp = resource_adc_scan_channel(ch_num);
+
+	if (!chp)
+		return;
+	chp->window.rank = rank;
+	_window_clear(&chp->window);
+}
+
+/*
+ * window length for the channel consumer to pick up on its next drain,
+ * the window restarts empty then. any thread
+ */
+int resource_adc_window_set_size(int ch_num, int size)
+{
+	adc_channel_t *chp = resource_adc_scan_channel(ch_num);
+
+	if (!chp || size < ADC_MIN_SIZE || size > ADC_MAX_SIZE)
+		return -1;
+	__atomic_store_n(&chp->window.size_req, size, __ATOMIC_RELAXED);
+
+	return 0;
+}
+
+int resource_adc_window_get_size(int ch_num)
+{
+	adc_channel_t *chp = resource_adc_scan_channel(ch_num);
+	int size;
+
+	if (!chp)
+		return -1;
+	size = __atomic_load_n(&chp->window.size_req, __ATOMIC_RELAXED);
+
+	return size ? size : ADC_MAX_SIZE;
+}
+
+static void _window_put(adc_window_t *win, short value)
+{
+	short *slot = &win->sensor_value[win->index];
+
+	if (win->bsize < win->size) {
+		win->bsize++;
+	} else {	// window is full, the oldest sample leaves
+		win->sum -= *slot;
+		win->sum_sq -= (unsigned long long)(*slot * *slot);
+		if (win->rank)
+			adc_rank_update(win->rank, *slot, -1);
+	}
+	*slot = value;
+	win->sum += *slot;
+	win->sum_sq += (unsigned long long)(*slot * *slot);
+	if (win->rank)
+		adc_rank_update(win->rank, *slot, 1);
+	if (win->sample_cb)
+		win->sample_cb(value, win->sample_data);
+
+	if (++win->index >= win->size)
+		win->index = 0;
+}
+
+/*
+ * run sample_cb for every new decimated sample (NULL: none), consumer only
+ */
+void resource_adc_window_set_sample_cb(int ch_num, adc_sample_cb sample_cb, void *user_data)
+{
+	adc_channel_t *chp = resource_adc_scan_channel(ch_num);
+
+	if (!chp)
+		return;
+	chp->window.sample_cb = sample_cb;
+	chp->window.sample_data = user_data;
+}
+
+/*
+ * move new samples from the channel ring into its averaging window,
+ * decimated to ADC_OUTPUT_BITS
+ */
+void resource_adc_window_drain(int ch_num)
+{
+	adc_channel_t *chp = resource_adc_scan_channel(ch_num);
+	adc_window_t *win;
+	short samples[ADC_DECIMATE + 256];
+	short decimated[ADC_DECIMATE + 256];	// up to one per raw sample with a 12bit adc
+	unsigned int reset;
+	int n, i, nblocks, factor;
+	int bits = resource_adc_get_driver()->bits;
+	int size;
+
+	if (!chp)
+		return;
+	win = &chp->window;
+	size = resource_adc_window_get_size(ch_num);
+
+	reset = __atomic_load_n(&chp->ring.reset, __ATOMIC_ACQUIRE);
+	if (bits != win->bits)	// raw samples of another chip are still in the ring
+		adc_ring_skip(&chp->ring);
+	if (reset != win->reset || bits != win->bits || size != win->size) {
+		win->reset = reset;
+		win->bits = bits;
+		win->size = size;
+		_window_clear(win);
+	}
+	factor = adc_decimate_factor(bits);
+
+	while (true) {
+		memcpy(samples, win->pending, win->npending * sizeof(short));
+		n = adc_ring_pop(&chp->ring, samples + win->npending, 256);
+		if (n <= 0)
+			break;
+		n += win->npending;
+
+		nblocks = n / factor;
+		adc_decimate(samples, nblocks, bits, decimated);
+		for (i = 0; i < nblocks; i++)
+			_window_put(win, decimated[i]);
+
+		win->npending = n - nblocks * factor;
+		memcpy(win->pending, samples + nblocks * factor, win->npending * sizeof(short));
+	}
+}
+
+/*
+ * average and standard deviation of the window, O(1) from the running sums
+ */
+int resource_adc_window_stat(int ch_num, float *average, float *stddev)
+{
+	adc_channel_t *chp = resource_adc_scan_channel(ch_num);
+	long long n, var;
+
+	if (!chp || !average)
+		return -1;
+
+	n = chp->window.bsize;
+	if (n == 0)
+		return -1;
+
+	*average = (float)chp->window.sum / (float)n;
+	if (stddev) {
+		var = ((long long)chp->window.sum_sq * n - chp->window.sum * chp->window.sum) / n;
+		*stddev = var > 0 ? sqrtf((float)var / (float)n) : 0.f;
+	}
+
+	return 0;
+}
+
+static unsigned long long _monotonic_ns(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (unsigned long long)ts.tv_sec * NSEC_PER_SEC + ts.tv_nsec;
+}
+
+static void _record_lateness(unsigned long long late_ns)
+{
+	unsigned int late_us = (late_ns / 1000 > 0xFFFFFFFFULL) ? 0xFFFFFFFF : (unsigned int)(late_ns / 1000);
+	int bucket = 0;
+
+	while (bucket < ADC_JITTER_BUCKETS - 1 && late_us >= (1U << bucket))
+		bucket++;
+	sched_stat.jitter[bucket]++;
+	if (late_us > sched_stat.max_late_us)
+		sched_stat.max_late_us = late_us;
+}
+
+/*
+ * run resource_adc_scan_once() on absolute deadlines until *done is set.
+ * a late wakeup skips the missed deadlines instead of scanning in a burst.
+ */
+void resource_adc_scan_loop(int *done, adc_scan_cb scan_cb, void *user_data)
+{
+	unsigned int rate = 0;
+	unsigned long long period = 0;
+	unsigned long long next = 0;
+	unsigned long long now, late;
+	struct timespec ts;
+
+	memset(&sched_stat, 0, sizeof(sched_stat));
+
+	while (!__atomic_load_n(done, __ATOMIC_ACQUIRE)) {
+		if (rate != resource_adc_scan_get_rate()) {	// (re)arm on rate change
+			rate = resource_adc_scan_get_rate();
+			period = NSEC_PER_SEC / rate;
+			next = _monotonic_ns() + period;
+			sched_stat.rate_hz = rate;
+		}
+
+		ts.tv_sec = next / NSEC_PER_SEC;
+		ts.tv_nsec = next % NSEC_PER_SEC;
+		if (clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &ts, NULL) == EINTR)
+			continue;
+
+		now = _monotonic_ns();
+		late = (now > next) ? now - next : 0;
+		_record_lateness(late);
+		if (late >= period) {
+			sched_stat.missed += late / period;
+			next += (late / period) * period;
+		}
+		next += period;
+		sched_stat.ticks++;
+
+		resource_adc_scan_once();
+		if (scan_cb)
+			scan_cb(user_data);
+	}
+}
@@ -0,0 +1,544 @@
+/*
+ * Copyright (c) 2018 Samsung Electronics Co., Ltd.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an AS IS BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <stdio.h>
+#include <string.h>
+#include <fcntl.h>
+#include <time.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <sys/ioctl.h>
+#include <linux/spi/spidev.h>
+#include <peripheral_io.h>
+#include "resource/resource_adc_spi.h"
+#include "log.h"
+
+#define ADC_SPI_BPW 8
+#define SPIDEV_PATH_LEN 32
+
+static peripheral_spi_h ADC_SPI_H = NULL;
+static int spidev_fd = -1;
+static unsigned int spidev_speed = 0;
+#if defined(ADC_SPI_SPIDEV)
+static adc_spi_backend_e spi_backend = ADC_SPI_BACKEND_SPIDEV;
+#else
+static adc_spi_backend_e spi_backend = ADC_SPI_BACKEND_PERIPHERAL;
+#endif
+static unsigned int ref_count = 0;
+static pthread_mutex_t ref_lock = PTHREAD_MUTEX_INITIALIZER;	// open / close, taken before bus_lock
+static pthread_mutex_t bus_lock = PTHREAD_MUTEX_INITIALIZER;	// one transfer or block on the bus at a time
+
+static const unsigned int spi_speed_ladder[] = {	// tuner clock steps, ascending
+	500000, 750000, 1000000, 1350000, 1800000, 2400000, 3000000, 3600000,
+};
+#define SPI_SPEED_LEVELS	(int)(sizeof(spi_speed_ladder) / sizeof(spi_speed_ladder[0]))
+
+static adc_spi_stat_t spi_stat = { .autotune = 1 };	// under bus_lock
+static int spi_level = 0;			// current ladder step
+static int spi_level_max = 0;		// highest step allowed by the chip
+static int spi_level_bad = SPI_SPEED_LEVELS;	// lowest step seen failing
+static int spi_clean_windows = 0;	// error free windows in a row
+static adc_spi_latency_t spi_latency;	// under bus_lock
+
+static unsigned long long _spi_now_ns(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (unsigned long long)ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+/*
+ * hdr style bucket: values below 2^SUB_BITS are exact, above that every
+ * power of 2 is split into 2^SUB_BITS linear sub buckets
+ */
+static int _spi_latency_index(unsigned int ns)
+{
+	int msb;
+
+	if (ns < (1U << ADC_SPI_LAT_SUB_BITS))
+		return ns;
+	msb = 31 - __builtin_clz(ns);
+
+	return ((msb - ADC_SPI_LAT_SUB_BITS + 1) << ADC_SPI_LAT_SUB_BITS)
+		+ ((ns >> (msb - ADC_SPI_LAT_SUB_BITS)) & ((1U << ADC_SPI_LAT_SUB_BITS) - 1));
+}
+
+/*
+ * lower bound of a histogram bucket in nsec
+ */
+unsigned int adc_spi_latency_bucket_ns(int bucket)
+{
+	int octave = bucket >> ADC_SPI_LAT_SUB_BITS;
+	unsigned int sub = bucket & ((1U << ADC_SPI_LAT_SUB_BITS) - 1);
+
+	if (octave == 0)
+		return sub;
+
+	return ((1U << ADC_SPI_LAT_SUB_BITS) | sub) << (octave - 1);
+}
+
+static void _spi_latency_record(unsigned long long start, int ret)
+{
+	unsigned long long ns = _spi_now_ns() - start;
+	unsigned int ns32 = (ns > 0xFFFFFFFFULL) ? 0xFFFFFFFF : (unsigned int)ns;
+
+	spi_latency.calls++;
+	spi_latency.total_ns += ns;
+	if (ns32 > spi_latency.max_ns)
+		spi_latency.max_ns = ns32;
+	spi_latency.hist[_spi_latency_index(ns32)]++;
+	if (ret < 0)
+		spi_latency.failed++;
+}
+
+static int _spi_is_open(void)
+{
+	return ADC_SPI_H != NULL || spidev_fd >= 0;
+}
+
+static int _spi_set_speed(unsigned int speed_hz)
+{
+	int ret;
+
+	if (spidev_fd >= 0) {	// spidev takes the clock per transfer
+		spidev_speed = speed_hz;
+		return 0;
+	}
+
+	ret = peripheral_spi_set_frequency(ADC_SPI_H, speed_hz);
+	if (PERIPHERAL_ERROR_NONE != ret) {
+		_E("peripheral_spi_set_frequency failed :%s ", get_error_message(ret));
+		return -1;
+	}
+
+	return 0;
+}
+
+static int _spi_set_level(int level)
+{
+	if (_spi_set_speed(spi_speed_ladder[level]) < 0)
+		return -1;
+	spi_level = level;
+	spi_stat.speed_hz = spi_speed_ladder[level];
+
+	return 0;
+}
+
+/*
+ * select peripheral_io or /dev/spidevB.C, before the device is opened
+ */
+int resource_adc_spi_set_backend(adc_spi_backend_e backend)
+{
+	int ret = -1;
+
+	if (backend < 0 || backend >= ADC_SPI_BACKEND_MAX)
+		return -1;
+
+	pthread_mutex_lock(&ref_lock);
+	if (ref_count == 0) {
+		spi_backend = backend;
+		ret = 0;
+	}
+	pthread_mutex_unlock(&ref_lock);
+
+	return ret;
+}
+
+adc_spi_backend_e resource_adc_spi_get_backend(void)
+{
+	adc_spi_backend_e backend;
+
+	pthread_mutex_lock(&ref_lock);
+	backend = spi_backend;
+	pthread_mutex_unlock(&ref_lock);
+
+	return backend;
+}
+
+/*
+ * spidev backend: the same mode 0, msb first, 8 bit setup through ioctl.
+ * the app needs read/write access to the device node.
+ */
+static int _spidev_open(int bus, int chip_select, unsigned int speed_hz)
+{
+	char path[SPIDEV_PATH_LEN];
+	unsigned char mode = SPI_MODE_0;
+	unsigned char lsb_first = 0;
+	unsigned char bits = ADC_SPI_BPW;
+
+	snprintf(path, sizeof(path), "/dev/spidev%d.%d", bus, chip_select);
+	spidev_fd = open(path, O_RDWR | O_CLOEXEC);
+	if (spidev_fd < 0) {
+		_E("spidev open failed: %s", path);
+		return -1;
+	}
+
+	if (ioctl(spidev_fd, SPI_IOC_WR_MODE, &mode) < 0
+		|| ioctl(spidev_fd, SPI_IOC_WR_LSB_FIRST, &lsb_first) < 0
+		|| ioctl(spidev_fd, SPI_IOC_WR_BITS_PER_WORD, &bits) < 0
+		|| ioctl(spidev_fd, SPI_IOC_WR_MAX_SPEED_HZ, &speed_hz) < 0) {
+		_E("spidev setup failed: %s", path);
+		close(spidev_fd);
+		spidev_fd = -1;
+		return -1;
+	}
+	spidev_speed = speed_hz;
+
+	return 0;
+}
+
+static int _peripheral_open(int bus, int chip_select, unsigned int speed_hz)
+{
+	int ret = 0;
+
+	ret = peripheral_spi_open(bus, chip_select, &ADC_SPI_H);
+	if (PERIPHERAL_ERROR_NONE != ret) {
+		_E("spi open failed :%s ", get_error_message(ret));
+		return -1;
+	}
+
+	ret = peripheral_spi_set_mode(ADC_SPI_H, PERIPHERAL_SPI_MODE_0);
+	if (PERIPHERAL_ERROR_NONE != ret) {
+		_E("peripheral_spi_set_mode failed :%s ", get_error_message(ret));
+		goto error_after_open;
+	}
+	ret = peripheral_spi_set_bit_order(ADC_SPI_H, PERIPHERAL_SPI_BIT_ORDER_MSB);
+	if (PERIPHERAL_ERROR_NONE != ret) {
+		_E("peripheral_spi_set_bit_order failed :%s ", get_error_message(ret));
+		goto error_after_open;
+	}
+
+	ret = peripheral_spi_set_bits_per_word(ADC_SPI_H, ADC_SPI_BPW);
+	if (PERIPHERAL_ERROR_NONE != ret) {
+		_E("peripheral_spi_set_bits_per_word failed :%s ", get_error_message(ret));
+		goto error_after_open;
+	}
+
+	ret = peripheral_spi_set_frequency(ADC_SPI_H, speed_hz);
+	if (PERIPHERAL_ERROR_NONE != ret) {
+		_E("peripheral_spi_set_frequency failed :%s ", get_error_message(ret));
+		goto error_after_open;
+	}
+
+	return 0;
+
+error_after_open:
+	peripheral_spi_close(ADC_SPI_H);
+	ADC_SPI_H = NULL;
+	return -1;
+}
+
+/*
+ * open the adc spi device (mode 0, msb first, 8 bit words), shared by reference count.
+ * every sampler thread opens it once; the first open configures the bus.
+ */
+int resource_adc_spi_open(unsigned int speed_hz)
+{
+	int ret = 0;
+	int bus = SPI_BUS_STDTA7D;
+	int chip_select = SPI_CS_STDTA7D;
+	int level_max;
+	unsigned int open_hz;
+
+	pthread_mutex_lock(&ref_lock);
+	if (ref_count > 0) {
+		ref_count++;
+		_D("SPI device already initialized [ref_count : %u]", ref_count);
+		pthread_mutex_unlock(&ref_lock);
+		return 0;
+	}
+
+	// tuner starts at the chip limit, the fastest step not above speed_hz.
+	// the bus runs on ladder steps only, so the first step down is the next one
+	for (level_max = SPI_SPEED_LEVELS - 1; level_max > 0; level_max--)
+		if (spi_speed_ladder[level_max] <= speed_hz)
+			break;
+	open_hz = (spi_speed_ladder[level_max] <= speed_hz) ? spi_speed_ladder[level_max] : speed_hz;
+
+	pthread_mutex_lock(&bus_lock);
+	if (spi_backend == ADC_SPI_BACKEND_SPIDEV)
+		ret = _spidev_open(bus, chip_select, open_hz);
+	else
+		ret = _peripheral_open(bus, chip_select, open_hz);
+	if (ret < 0) {
+		_D("%s error: %d", __func__, ref_count);
+		pthread_mutex_unlock(&bus_lock);
+		pthread_mutex_unlock(&ref_lock);
+		return -1;
+	}
+	_D("%s success: %d, %s", __func__, ref_count, spi_backend == ADC_SPI_BACKEND_SPIDEV ? "spidev" : "peripheral_io");
+
+	if (spi_latency.opens++ > 0)
+		spi_latency.reopens++;
+
+	spi_level_max = level_max;
+	spi_level = spi_level_max;
+	spi_level_bad = SPI_SPEED_LEVELS;
+	spi_clean_windows = 0;
+	spi_stat.speed_hz = open_hz;
+	spi_stat.max_hz = open_hz;
+	spi_stat.frames = spi_stat.bad_frames = 0;
+	spi_stat.window_frames = spi_stat.window_bad = 0;
+	spi_stat.steps_up = spi_stat.steps_down = 0;
+	pthread_mutex_unlock(&bus_lock);
+
+	ref_count++;
+	pthread_mutex_unlock(&ref_lock);
+
+	return 0;
+}
+
+static void _spidev_xfer(struct spi_ioc_transfer *xfer, unsigned char *tx, unsigned char *rx, int len)
+{
+	memset(xfer, 0, sizeof(*xfer));
+	xfer->tx_buf = (unsigned long)tx;
+	xfer->rx_buf = (unsigned long)rx;
+	xfer->len = len;
+	xfer->speed_hz = spidev_speed;
+	xfer->bits_per_word = ADC_SPI_BPW;
+}
+
+static int _spi_transfer(unsigned char *tx, unsigned char *rx, int len)
+{
+	struct spi_ioc_transfer xfer;
+	unsigned long long start;
+	int ret;
+
+	if (!_spi_is_open())
+		return -1;
+
+	start = _spi_now_ns();
+	if (spidev_fd >= 0) {
+		_spidev_xfer(&xfer, tx, rx, len);
+		ret = (ioctl(spidev_fd, SPI_IOC_MESSAGE(1), &xfer) < 0) ? -1 : 0;
+	} else {
+		ret = (peripheral_spi_transfer(ADC_SPI_H, tx, rx, len) == PERIPHERAL_ERROR_NONE) ? 0 : -1;
+	}
+	_spi_latency_record(start, ret);
+
+	return ret;
+}
+
+/*
+ * one full duplex transfer with chip select held low
+ */
+int resource_adc_spi_transfer(unsigned char *tx, unsigned char *rx, int len)
+{
+	int ret;
+
+	pthread_mutex_lock(&bus_lock);
+	ret = _spi_transfer(tx, rx, len);
+	pthread_mutex_unlock(&bus_lock);
+
+	return ret;
+}
+
+/*
+ * nframes transfers of frame_len bytes, chip select released between frames.
+ * spidev queues all of them in one ioctl, peripheral_io needs a call per frame.
+ * returns 0 if all frames were transferred; rx of a failed frame reads 0xFF.
+ * the bus is held for the whole block.
+ */
+int resource_adc_spi_transfer_frames(unsigned char *tx, unsigned char *rx, int frame_len, int nframes)
+{
+	struct spi_ioc_transfer xfer[ADC_SPI_FRAMES_MAX];
+	unsigned long long start;
+	int i, ret = 0;
+
+	if (nframes <= 0 || nframes > ADC_SPI_FRAMES_MAX)
+		return -1;
+
+	pthread_mutex_lock(&bus_lock);
+	if (spidev_fd >= 0) {
+		for (i = 0; i < nframes; i++) {
+			_spidev_xfer(&xfer[i], tx + i * frame_len, rx + i * frame_len, frame_len);
+			xfer[i].cs_change = (i < nframes - 1);	// on the last one it would keep CS low
+		}
+		start = _spi_now_ns();
+		ret = (ioctl(spidev_fd, SPI_IOC_MESSAGE(nframes), xfer) < 0) ? -1 : 0;
+		_spi_latency_record(start, ret);
+		if (ret < 0)
+			memset(rx, 0xFF, frame_len * nframes);
+	} else {
+		for (i = 0; i < nframes; i++) {
+			if (_spi_transfer(tx + i * frame_len, rx + i * frame_len, frame_len) < 0) {
+				memset(rx + i * frame_len, 0xFF, frame_len);
+				ret = -1;
+			}
+		}
+	}
+	pthread_mutex_unlock(&bus_lock);
+
+	return ret;
+}
+
+/*
+ * close one error rate window: a noisy clock is stepped down and remembered
+ * as bad, a clean one is stepped up unless the next step failed before.
+ * the tuner settles just below the slowest failing clock.
+ */
+static void _spi_tune_window(void)
+{
+	unsigned int bad = spi_stat.window_bad;
+
+	if (bad * ADC_SPI_TUNE_ERR_DEN > spi_stat.window_frames) {
+		spi_clean_windows = 0;
+		if (spi_level < spi_level_bad)
+			spi_level_bad = spi_level;
+		if (spi_level > 0 && _spi_set_level(spi_level - 1) == 0) {
+			spi_stat.steps_down++;
+			_D("spi clock down: %u Hz, %u bad of %u", spi_stat.speed_hz, bad, spi_stat.window_frames);
+		}
+	} else if (bad == 0) {
+		if (++spi_clean_windows >= ADC_SPI_TUNE_RETRY && spi_level_bad < SPI_SPEED_LEVELS) {
+			spi_level_bad = SPI_SPEED_LEVELS;	// give the failed clock another chance
+			spi_clean_windows = 0;
+		}
+		if (spi_level < spi_level_max && spi_level + 1 < spi_level_bad && _spi_set_level(spi_level + 1) == 0) {
+			spi_stat.steps_up++;
+			_D("spi clock up: %u Hz", spi_stat.speed_hz);
+		}
+	}
+
+	spi_stat.window_frames = 0;
+	spi_stat.window_bad = 0;
+}
+
+/*
+ * frame check results from the adc driver, any sampler thread
+ */
+void resource_adc_spi_account(int good, int bad)
+{
+	if (good < 0 || bad < 0)
+		return;
+
+	pthread_mutex_lock(&bus_lock);
+	spi_stat.frames += good + bad;
+	spi_stat.bad_frames += bad;
+	spi_stat.window_frames += good + bad;
+	spi_stat.window_bad += bad;
+
+	if (spi_stat.window_frames >= ADC_SPI_TUNE_WINDOW) {
+		if (_spi_is_open() && __atomic_load_n(&spi_stat.autotune, __ATOMIC_RELAXED))
+			_spi_tune_window();
+		else
+			spi_stat.window_frames = spi_stat.window_bad = 0;
+	}
+	pthread_mutex_unlock(&bus_lock);
+}
+
+/*
+ * enable (default) or disable the clock tuner, disabled keeps the current clock
+ */
+void resource_adc_spi_set_autotune(int enable)
+{
+	__atomic_store_n(&spi_stat.autotune, enable ? 1 : 0, __ATOMIC_RELAXED);
+}
+
+/*
+ * copy of the tuner state
+ */
+void resource_adc_spi_get_stat(adc_spi_stat_t *stat)
+{
+	if (!stat)
+		return;
+
+	pthread_mutex_lock(&bus_lock);
+	memcpy(stat, &spi_stat, sizeof(*stat));
+	pthread_mutex_unlock(&bus_lock);
+}
+
+/*
+ * copy of the bus call instrumentation
+ */
+void resource_adc_spi_get_latency(adc_spi_latency_t *lat)
+{
+	if (!lat)
+		return;
+
+	pthread_mutex_lock(&bus_lock);
+	memcpy(lat, &spi_latency, sizeof(*lat));
+	pthread_mutex_unlock(&bus_lock);
+}
+
+/*
+ * lower bound of the bucket holding the percent-th percentile call latency (nsec)
+ */
+unsigned int adc_spi_latency_percentile(const adc_spi_latency_t *lat, int percent)
+{
+	unsigned long long total = 0, want;
+	int i;
+
+	for (i = 0; i < ADC_SPI_LAT_BUCKETS; i++)
+		total += lat->hist[i];
+	if (total == 0)
+		return 0;
+
+	want = (total * percent + 99) / 100;
+	for (i = 0, total = 0; i < ADC_SPI_LAT_BUCKETS; i++) {
+		total += lat->hist[i];
+		if (total >= want && total > 0)
+			return adc_spi_latency_bucket_ns(i);
+	}
+
+	return lat->max_ns;
+}
+
+/*
+ * log spi clock, frame counts and the latency histogram
+ */
+void resource_adc_spi_dump(void)
+{
+	adc_spi_stat_t stat;
+	adc_spi_latency_t lat;
+	int i;
+
+	resource_adc_spi_get_stat(&stat);
+	resource_adc_spi_get_latency(&lat);
+
+	_I("spi: %u Hz (max %u, tune %d, up %u, down %u), frames %llu, bad %llu",
+		stat.speed_hz, stat.max_hz, stat.autotune, stat.steps_up, stat.steps_down, stat.frames, stat.bad_frames);
+	_I("spi calls: %llu, failed %u, opens %u, reopens %u, avg %llu ns, p50 %u, p99 %u, max %u ns",
+		lat.calls, lat.failed, lat.opens, lat.reopens, lat.calls ? lat.total_ns / lat.calls : 0,
+		adc_spi_latency_percentile(&lat, 50), adc_spi_latency_percentile(&lat, 99), lat.max_ns);
+	for (i = 0; i < ADC_SPI_LAT_BUCKETS; i++) {
+		if (lat.hist[i])
+			_I("spi latency >= %u ns: %u", adc_spi_latency_bucket_ns(i), lat.hist[i]);
+	}
+}
+
+void resource_adc_spi_close(void)
+{
+	pthread_mutex_lock(&ref_lock);
+	if (ref_count == 0) {
+		pthread_mutex_unlock(&ref_lock);
+		return;
+	}
+
+	if (--ref_count == 0) {
+		pthread_mutex_lock(&bus_lock);	// wait for a transfer in flight
+		if (spidev_fd >= 0) {
+			close(spidev_fd);
+			spidev_fd = -1;
+		} else {
+			peripheral_spi_close(ADC_SPI_H);
+			ADC_SPI_H = NULL;
+		}
+		pthread_mutex_unlock(&bus_lock);
+	}
+	pthread_mutex_unlock(&ref_lock);
+}
@@ -0,0 +1,166 @@
+/*
+ * Copyright (c) 2018 Samsung Electronics Co., Ltd.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an AS IS BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <math.h>
+#include "resource/resource_co2_mg811.h"
+#if defined(__DEBUG__)
+#include "log.h"
+#endif
+
+#if !defined(CO2_FIXED_POINT) || defined(CO2_MG811_BOTH)
+#define MG811_FLOAT
+#endif
+#if defined(CO2_FIXED_POINT) || defined(CO2_MG811_BOTH)
+#define MG811_FIXED
+#endif
+
+#define DC_GAIN			(8.500)		// refer to schematic, (R2 + R3) / R2 = 8.5
+
+#define POINT_X_ZERO	(2.60206)	// the start point, log(400)=2.6020606
+#define POINT_X_MAX		(4.000)		// the start point, log(10000)=4.0
+#define	VOLT_V_ZERO		(0.3245)	// refer to datasheet, 400ppm(V)
+#define VOLT_V_MAX		(0.2645)	// refer to datasheet, 10000ppm(V)
+#define VOLT_V_REACT	(VOLT_V_ZERO - VOLT_V_MAX)
+
+/*
+ * CO2_FIXED_POINT: integer only ppm conversion for soft-float targets.
+ * it is not bit-exact with the float path: results may differ by 1 ppm
+ * (423 of 110619 conversions over every adc code 0 to 4096 for 2000 to
+ * 3300 mV zero points, checked by test/test_co2_mg811.c). the float path
+ * truncates pow() and the 2^x table rounds differently near integer
+ * boundaries. range decisions (-1, 10000) match.
+ */
+#if defined(MG811_FIXED)
+#define Q16_ONE				(1 << 16)
+#define DC_GAIN_X2			17			// DC_GAIN * 2
+#define ADC_REF_MV			3320		// ADC_REF_VOLT
+#define ADC_CODE_NV_NUM		(ADC_REF_MV * 2000000LL)			// sensor nV per adc code, numerator
+#define ADC_CODE_NV_DEN		((int)ADC_MAX_VOLT * DC_GAIN_X2)	// sensor nV per adc code, denominator
+#define SLOPE_NV			((long long)(VOLT_V_REACT / (POINT_X_MAX - POINT_X_ZERO) * 1e9))	// nV per ppm decade
+#define POINT_X_ZERO_Q16	((long long)(POINT_X_ZERO * Q16_ONE))
+#define LOG2_10_Q16			217706		// log2(10) in Q16
+
+static long long mg811_zero_nv;	// sensor voltage at 400 ppm (nV)
+static long long mg811_max_nv;	// sensor voltage at 10000 ppm (nV)
+static const int exp2_q16[33] = {	// 2^(i/32) in Q16
+	65536, 66971, 68438, 69936, 71468, 73032, 74632, 76266,
+	77936, 79642, 81386, 83169, 84990, 86851, 88752, 90696,
+	92682, 94711, 96785, 98905, 101070, 103283, 105545, 107856,
+	110218, 112631, 115098, 117618, 120194, 122825, 125515, 128263,
+	131072,
+};
+
+/*
+ * initial co2 mg811 sensor for ppm caculation, zero_mv is adc input at 400 ppm
+ */
+void resource_co2_mg811_init_fixed(int zero_mv)
+{
+	if (zero_mv == 0)
+		zero_mv = (int)(DEFAULT_ZERO_VOLTS * 1000);
+
+	mg811_zero_nv = (long long)zero_mv * 2000000 / DC_GAIN_X2;
+	mg811_max_nv = (long long)(zero_mv - (int)(DEFAULT_RANGE_VOLTS * 1000)) * 2000000 / DC_GAIN_X2;
+#if defined(__DEBUG__)
+	_D("CO2Volage zero_volts: %lld uV, max_volts: %lld uV, slope %lld nV",
+			mg811_zero_nv / 1000, mg811_max_nv / 1000, SLOPE_NV);
+#endif
+}
+
+/*
+ * integer part of 2^y, y in Q16
+ */
+static int _exp2_q16(long long y)
+{
+	int ip = (int)(y >> 16);
+	int f = (int)(y & 0xFFFF);
+	int idx = f >> 11;		// 32 table steps
+	int frac = f & 0x7FF;
+	long long m;
+
+	m = exp2_q16[idx] + (((long long)(exp2_q16[idx + 1] - exp2_q16[idx]) * frac) >> 11);
+
+	return (int)((m << ip) >> 16);
+}
+
+/*
+ * get ppm value in co2 mg811 sensor for 12bit adc code
+ */
+int resource_co2_mg811_ppm_fixed(int code)
+{
+	long long volts_nv = (long long)code * ADC_CODE_NV_NUM / ADC_CODE_NV_DEN;
+	long long log_q16;
+
+	if (!(volts_nv <= mg811_zero_nv && volts_nv >= mg811_max_nv)) {
+		if (volts_nv < mg811_max_nv) {
+			return 10000;
+		}
+		return -1;
+	}
+	log_q16 = ((mg811_zero_nv - volts_nv) << 16) / SLOPE_NV + POINT_X_ZERO_Q16;
+
+	return _exp2_q16((log_q16 * LOG2_10_Q16) >> 16);	// 10^x = 2^(x * log2(10))
+}
+#endif
+
+#if defined(MG811_FLOAT)
+static float mg811_co2_slope;	// refer to datasheet, mg811 co2 slope value
+static sensor_mg811_t mg_sensor;
+
+/*
+ * initial co2 mg811 sensor for ppm caculation, zero_mv is adc input at 400 ppm
+ */
+void resource_co2_mg811_init_float(int zero_mv)
+{
+	sensor_mg811_t *sen = &mg_sensor;
+	float zero_volts;	// measurement mutimeter voltage (V)
+	float reaction_volts;
+
+	zero_volts = (float)zero_mv / 1000.0;
+	if (zero_volts == 0.0)
+		zero_volts = DEFAULT_ZERO_VOLTS;
+
+	sen->zero_point_volts = zero_volts / DC_GAIN;
+	sen->max_point_volts = (zero_volts - DEFAULT_RANGE_VOLTS) / DC_GAIN;
+	reaction_volts = VOLT_V_REACT;
+	mg811_co2_slope = reaction_volts / (POINT_X_ZERO - POINT_X_MAX);
+#if defined(__DEBUG__)
+	_D("CO2Volage zero_volts: %.f mV, max_volts: %.f mV, reaction %.f mV",
+			sen->zero_point_volts * 1000., sen->max_point_volts * 1000., reaction_volts * 1000.);
+	_D("mg811_ppm: %.3f V, %.3f", POINT_X_ZERO, mg811_co2_slope);
+#endif
+}
+
+/*
+ * get ppm value in co2 mg811 sensor for 12bit adc code
+ */
+int resource_co2_mg811_ppm_float(int code)
+{
+	float volts = ((float)code * ADC_REF_VOLT) / ADC_MAX_VOLT / 1000.f;
+	sensor_mg811_t *sen = &mg_sensor;
+	float log_volts = 0;
+
+	volts = volts / DC_GAIN;
+	if (!(volts <= sen->zero_point_volts && volts >= sen->max_point_volts)) {
+		if (volts < sen->max_point_volts) {
+			return 10000;
+		}
+		return -1;
+	}
+	log_volts = (volts - sen->zero_point_volts) / mg811_co2_slope;
+
+	return pow(10, log_volts + POINT_X_ZERO);
+}
+#endif
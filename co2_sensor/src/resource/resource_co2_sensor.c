@@ -15,153 +15,390 @@
  */
 
 #include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
 #include <unistd.h>
-#include <math.h>
+#include <errno.h>
+#include <time.h>
 #include <app_common.h>
 #include "smartthings_resource.h"
+#include "resource/resource_adc.h"
+#include "resource/resource_adc_spi.h"
 #include "resource/resource_co2_sensor.h"
+#include "resource/resource_co2_mg811.h"
 #include "log.h"
 
 #define CO2_DATA			"co2_data"	// save co2 data
+#define CO2_DATA_LINE_LEN	192			// see _load_sensor_parameter(), any int and float values
 
 #define MAX_PATH_LEN		128
-#define DC_GAIN				(8.500)		// refer to schematic, (R2 + R3) / R2 = 8.5
-#define DEFAULT_ZERO_VOLTS	(2.950)
-#define DEFAULT_RANGE_VOLTS	(0.400)		// refer to datasheet
 #define DEFAULT_NOTIFY_TIME	(100)		// 1000msec
+#define NOTIFY_TIME_UNIT	(10)		// msec per notify time count
+#define NOTIFY_TIME_MIN		(10)		// 100msec
+#define NOTIFY_TIME_MAX		(360000)	// 1 hour
 
 #define ADC_PIN				0			// adc pin number
+#define ADC_SCAN_CHANNELS	(1 << ADC_PIN)	// adc channels to sample, add extra analog sensors here
 #define ADC_ERROR			(-9999)		// adc read error
-#define ADC_MAX_VOLT		(4096.f)	// 12bit resolution
-#define ADC_REF_VOLT		(3300.f + 20.f)
 
-#define SPI_MAX_VOLT		(3200.f)
-#define SPI_REF_VOLT		(3000.f)
+#define PPM_TABLE_SIZE	CO2_MG811_CODES	// one entry per 12bit adc code
 
-#define POINT_X_ZERO	(2.60206)	// the start point, log(400)=2.6020606
-#define POINT_X_MAX		(4.000)		// the start point, log(10000)=4.0
-#define	VOLT_V_ZERO		(0.3245)	// refer to datasheet, 400ppm(V)
-#define VOLT_V_MAX		(0.2645)	// refer to datasheet, 10000ppm(V)
-#define VOLT_V_REACT	(VOLT_V_ZERO - VOLT_V_MAX)
+#define AGGREGATE_SAMPLES	64			// new window samples per published co2 value
+#define AGGREGATE_TIMEOUT	(1000)		// msec, publish even if the sampler stalls
+#define CO2_ALARM_PPM		1000		// reaching this sends a notification at once
+#define CO2_ALARM_CLEAR_PPM	950			// alarm clears below this, so a noisy level does not flap
+#define CUSUM_DRIFT			25			// ppm, changes smaller than this are ignored
+#define CUSUM_THRESHOLD		200			// ppm, accumulated change that sends a notification
+#define CUSUM_MEAN_SHIFT	4			// idle reference level follows ppm by 1/16 per value
+#define TREND_INTERVAL_MS	(10 * 1000)	// one trend point per 10 sec
+#define PERCENTILE_PERIOD_MS	(60 * 1000)	// percentiles are reported per minute
+#define DIAG_PERIOD_MS		1000		// diagnostics rates are measured per second
+#define AGGREGATE_EVENT_BLOCK	0x01	// sampler filled a block
 
 static const char* RES_CAPABILITY_AIRQUALITYSENSOR = "/capability/airQualitySensor/main/0";
 static const char* PROP_AIRQUALITY = "airQuality";
+static const char* PROP_TREND = "trend";
+static const char* PROP_PERCENTILES = "percentiles";
 
-static float mg811_co2_slope;	// refer to datasheet, mg811 co2 slope value
-static sensor_mg811_t mg_sensor;
+static short ppm_table[2][PPM_TABLE_SIZE];	// adc code -> ppm, double buffered
+static short *ppm_lut = NULL;				// table in use, swapped atomically
+static pthread_mutex_t ppm_lock = PTHREAD_MUTEX_INITIALIZER;	// serialize table rebuild
+
+static pthread_once_t sensor_param_once = PTHREAD_ONCE_INIT;
+static pthread_mutex_t sensor_param_lock = PTHREAD_MUTEX_INITIALIZER;	// serialize updates
+static co2_sensor_param_t sensor_param[2];			// double buffered
+static co2_sensor_param_t *sensor_param_p = NULL;	// parameters in use, swapped atomically
+
+typedef struct __co2_event__ {		// wakeup for a worker thread
+	pthread_mutex_t lock;
+	pthread_cond_t cond;
+	unsigned int event;					// pending event bits, under lock
+} co2_event_t;
+
+static pthread_once_t event_once = PTHREAD_ONCE_INIT;
+static co2_event_t notify_ev = { PTHREAD_MUTEX_INITIALIZER, PTHREAD_COND_INITIALIZER, 0 };
+static co2_event_t aggregate_ev = { PTHREAD_MUTEX_INITIALIZER, PTHREAD_COND_INITIALIZER, 0 };
+
+static adc_rank_t co2_rank;				// order statistics of co2 window, aggregate thread
+static co2_estimator_e co2_estimator = CO2_ESTIMATOR_MEAN;
+
+typedef struct __co2_cusum__ {		// two sided cusum step detector, aggregate thread only
+	int started;
+	int mean;						// reference level, ppm << 8
+	int s_hi;						// accumulated rise above mean + drift
+	int s_lo;						// accumulated fall below mean - drift
+} co2_cusum_t;
+
+static co2_cusum_t co2_cusum;
+static int co2_step_ppm = -1;			// block ppm that tripped the last step event
+
+typedef struct __co2_block__ {		// samples new since the last aggregate round, aggregate thread only
+	long long sum;
+	int n;
+} co2_block_t;
+
+static co2_block_t co2_block;
+
+static const adc_driver_t *adc_driver_req = NULL;	// chip to switch to, picked up by sampler thread
+static int spi_backend_req = -1;		// spi backend to reopen with, picked up by sampler thread
+
+typedef struct __co2_trend__ {		// least squares slope over the last n points, aggregate thread only
+	int points;						// window length, points
+	int n;							// points in window
+	int index;						// next slot in y
+	long long sum_y;				// sum of y
+	long long sum_iy;				// sum of i * y, i from 0 (oldest) to n - 1
+	unsigned long long next;		// msec when next point is due
+	int y[CO2_TREND_POINTS_MAX];
+} co2_trend_t;
+
+static co2_trend_t co2_trend;
+static int trend_points = CO2_TREND_POINTS;	// requested window length
+
+typedef struct __co2_diag_acc__ {	// diagnostics of the running period, aggregate thread only
+	unsigned long long start;		// msec
+	unsigned int head;				// ring head at start
+	unsigned long long frames;		// spi frames at start
+	unsigned long long bad_frames;
+	unsigned long long estimate_ns;	// aggregate time in this period
+	int estimates;
+} co2_diag_acc_t;
+
+static co2_sensor_diag_t co2_diag;
+static pthread_mutex_t diag_lock = PTHREAD_MUTEX_INITIALIZER;
+
+static const float co2_percentile_p[CO2_PERCENTILES] = { 0.50f, 0.95f, 0.99f };
+static p2_quantile_t co2_quantile[CO2_PERCENTILES];	// current minute, aggregate thread only
+
+typedef struct __co2_kalman__ {		// random walk model, aggregate thread only
+	double x;						// estimated adc value, double: a gain near 1e-3 moves it by less than a float ulp
+	double p;						// estimate variance, 0: not started
+	double q;						// process noise
+	double r;						// measurement noise
+} co2_kalman_t;
+
+static co2_kalman_t co2_kalman;
+static pthread_mutex_t kalman_lock = PTHREAD_MUTEX_INITIALIZER;
+static float kalman_q = CO2_KALMAN_Q;	// tuning, kalman_lock
+static float kalman_r = CO2_KALMAN_R;
+
+static unsigned int snapshot_seq = 0;	// odd while snapshot is written
+static co2_sensor_snapshot_t snapshot = {
+	.ppm = -1,
+	.percentile = { [0 ... CO2_PERCENTILES - 1] = -1.f },	// none before the first minute
+};
 
-co2_sensor_data_t	co2_sensor;
 int thread_done = 0;
-extern int32_t g_co2_sensor_value;
+int spi_dump_request = 0;	// set by SIGUSR1, aggregate thread logs the spi statistics
 extern bool g_switch_is_on;
 extern smartthings_resource_h st_handle;
 
-extern int resource_read_adc_mcp3008(int ch_num, unsigned int *out_value); /* resource_adc_mcp3008.c */
-extern int resource_adc_mcp3008_init(void); /* resource_adc_mcp3008.c */
 
-static int _get_sensor_parameter(int index);
+static void _get_sensor_parameter(co2_sensor_param_t *param);
+static int _co2_trend_points(int sec);
 
 /*
- * initial co2 mg811 sensor for ppm caculation
+ * rebuild adc code to ppm table with current mg811 calibration
  */
-static void _init_co2_mg811_set(float zero_volts, float max_volts)
+static void _build_co2_ppm_table(void)
 {
-	sensor_mg811_t *sen = &mg_sensor;
-	float reaction_volts;
+	short *table;
+	int code;
 
-	if (zero_volts == 0.f)
-		zero_volts = VOLT_V_ZERO;
-	if (max_volts == 0.f)
-		max_volts = VOLT_V_MAX;
+	table = (ppm_lut == ppm_table[0]) ? ppm_table[1] : ppm_table[0];
+	for (code = 0; code < PPM_TABLE_SIZE; code++)
+		table[code] = resource_co2_mg811_ppm(code);
 
-	sen->zero_point_volts = zero_volts;
-	sen->max_point_volts = max_volts;
-	reaction_volts = VOLT_V_REACT;
-	mg811_co2_slope = reaction_volts / (POINT_X_ZERO - POINT_X_MAX);
-#if defined(__DEBUG__)
-	_D("CO2Volage zero_volts: %.f mV, max_volts: %.f mV, reaction %.f mV",
-			sen->zero_point_volts * 1000., sen->max_point_volts * 1000., reaction_volts * 1000.);
-	_D("mg811_ppm: %.3f V, %.3f", POINT_X_ZERO, mg811_co2_slope);
-#endif
+	__atomic_store_n(&ppm_lut, table, __ATOMIC_RELEASE);
 }
 
 /*
- * get ppm value in co2 mg811 sensor
+ * get ppm value for average adc code sum / n, interpolated between table entries
  */
-static int _get_co2_mg811_ppm(float volts)
+static int _lookup_co2_ppm(long long sum, long long n)
 {
-	static int debug = 0;
-	sensor_mg811_t *sen = &mg_sensor;
-	float log_volts = 0;
-
-	volts = volts / DC_GAIN;
-	if (!(volts <= sen->zero_point_volts && volts >= sen->max_point_volts)) {
-		if ((debug++ % 10) == 0) {
-			_D("wrong input %.f mV, voltage range %.f ~ %.f (400 ppm ~ 10000 ppm)",
-				volts * 1000., sen->zero_point_volts * 1000., sen->max_point_volts * 1000.);
-		}
-		if (volts < sen->max_point_volts) {
-			return 10000;
-		}
+	const short *table = __atomic_load_n(&ppm_lut, __ATOMIC_ACQUIRE);
+	long long code, rem;
+	int lo, hi;
+
+	if (!table || n <= 0 || sum < 0)
 		return -1;
-	}
-	log_volts = (volts - sen->zero_point_volts) / mg811_co2_slope;
 
-	return pow(10, log_volts + POINT_X_ZERO);
+	code = sum / n;
+	rem = sum % n;
+	if (code >= PPM_TABLE_SIZE - 1)
+		return table[PPM_TABLE_SIZE - 1];
+
+	lo = table[code];
+	hi = table[code + 1];
+	if (lo < 0 || hi < 0)	// don't interpolate into out of range entry
+		return (rem * 2 < n) ? lo : hi;
+
+	return lo + (int)(((long long)(hi - lo) * rem) / n);
 }
 
 /*
- * get adc to co2 sensor analog value
+ * publish latest co2 value, aggregate thread only
  */
-static short resource_get_co2_sensor_analog(int ch_num)
+static void _publish_co2_snapshot(co2_sensor_snapshot_t *snap)
 {
-	int ret = 0;
-	unsigned int out_value = 0;
-	float sensor_value = 0;
+	unsigned int seq = snapshot_seq;
+
+	snap->seq = seq / 2 + 1;
+	__atomic_store_n(&snapshot_seq, seq + 1, __ATOMIC_RELAXED);
+	__atomic_thread_fence(__ATOMIC_RELEASE);
+	memcpy(&snapshot, snap, sizeof(snapshot));
+	__atomic_store_n(&snapshot_seq, seq + 2, __ATOMIC_RELEASE);
+}
 
-	ret = resource_read_adc_mcp3008(ch_num, &out_value);
-	if (ret < 0)
-		return ret;
-	sensor_value = ((float)out_value * 4.) * (SPI_REF_VOLT / SPI_MAX_VOLT);	// 10bit -> 12bit, calibration adc volt
+/*
+ * get latest co2 value published by aggregate thread, constant time
+ */
+void resource_get_co2_sensor_snapshot(co2_sensor_snapshot_t *snap)
+{
+	unsigned int seq;
 
-	return (short)sensor_value;
+	do {
+		seq = __atomic_load_n(&snapshot_seq, __ATOMIC_ACQUIRE);
+		memcpy(snap, &snapshot, sizeof(*snap));
+		__atomic_thread_fence(__ATOMIC_ACQUIRE);
+	} while ((seq & 1) || seq != __atomic_load_n(&snapshot_seq, __ATOMIC_RELAXED));
 }
 
 /*
- * update to average co2 ppm value
+ * get latest average co2 ppm value
  */
 int resource_update_co2_sensor_value(void)
 {
-	co2_sensor_data_t *sensorp = &co2_sensor;
-	float sensor_value = 0;
-	float sensor_fvalue = 0;
-	int n, percentage;
-	int size = 0;
-	static int debug = 0;
+	co2_sensor_snapshot_t snap;
+
+	resource_get_co2_sensor_snapshot(&snap);
+
+	return snap.ppm;
+}
+
+int resource_set_co2_sensor_estimator(co2_estimator_e estimator)
+{
+	if (estimator < 0 || estimator >= CO2_ESTIMATOR_MAX)
+		return -1;
+	__atomic_store_n(&co2_estimator, estimator, __ATOMIC_RELAXED);
+	_D("co2 estimator: %d", estimator);
+
+	return 0;
+}
+
+co2_estimator_e resource_get_co2_sensor_estimator(void)
+{
+	return __atomic_load_n(&co2_estimator, __ATOMIC_RELAXED);
+}
 
-	MUTEX_LOCK;
-	if (sensorp->bsize < ADC_MAX_SIZE)
-		size = sensorp->bsize;
-	else
-		size = ADC_MAX_SIZE;
-	MUTEX_UNLOCK;
+/*
+ * set kalman filter noise, smaller process_noise / measure_noise is smoother but slower
+ */
+int resource_set_co2_sensor_kalman(float process_noise, float measure_noise)
+{
+	if (!(process_noise > 0.f) || !(measure_noise > 0.f))
+		return -1;
+
+	pthread_mutex_lock(&kalman_lock);
+	kalman_q = process_noise;
+	kalman_r = measure_noise;
+	pthread_mutex_unlock(&kalman_lock);
+	_D("co2 kalman: q %g, r %g", process_noise, measure_noise);
 
-	for (n = 0; n < size; n++) {
-		MUTEX_LOCK;
-		sensor_value += (float)sensorp->sensor_value[n];
-		MUTEX_UNLOCK;
+	return 0;
+}
+
+void resource_get_co2_sensor_kalman(float *process_noise, float *measure_noise)
+{
+	pthread_mutex_lock(&kalman_lock);
+	if (process_noise)
+		*process_noise = kalman_q;
+	if (measure_noise)
+		*measure_noise = kalman_r;
+	pthread_mutex_unlock(&kalman_lock);
+}
+
+/*
+ * window sample callback, one kalman step per sample
+ */
+static void _co2_kalman_update(short value, void *user_data)
+{
+	co2_kalman_t *kf = user_data;
+	double gain;
+
+	if (kf->p == 0.) {
+		kf->x = value;
+		kf->p = kf->r;
+		return;
 	}
-	sensor_value = sensor_value / (float)size;
 
-	sensor_fvalue = (sensor_value * ADC_REF_VOLT) / ADC_MAX_VOLT;
-	percentage = _get_co2_mg811_ppm(sensor_fvalue / 1000.f);
+	kf->p += kf->q;
+	gain = kf->p / (kf->p + kf->r);
+	kf->x += gain * ((double)value - kf->x);
+	kf->p *= (1. - gain);
+}
 
-	if (percentage < 0 || percentage >= 10000) {
-		if ((debug++ % 5) == 0)
-			_D("sensor: %.f, volt: %.2f mV, CO2: %d ppm", sensor_value, sensor_fvalue, percentage);
+/*
+ * window sample callback, every sample is fed to the kalman filter and to the
+ * step detector block
+ */
+static void _co2_sample_update(short value, void *user_data)
+{
+	_co2_kalman_update(value, &co2_kalman);
+	co2_block.sum += value;
+	co2_block.n++;
+}
+
+/*
+ * feed one block ppm value to the per minute percentile estimators. the
+ * window value is already smoothed and would squeeze the upper percentiles
+ */
+static void _co2_percentile_add(int ppm)
+{
+	int i;
+
+	if (ppm < 0)	// out of sensor range
+		return;
+	for (i = 0; i < CO2_PERCENTILES; i++)
+		p2_quantile_add(&co2_quantile[i], ppm);
+}
+
+/*
+ * close the current minute: keep its percentiles, start a new one
+ */
+static void _co2_percentile_roll(float percentile[])
+{
+	int i;
+
+	for (i = 0; i < CO2_PERCENTILES; i++) {
+		percentile[i] = co2_quantile[i].count ? p2_quantile_get(&co2_quantile[i]) : -1.f;
+		p2_quantile_init(&co2_quantile[i], co2_percentile_p[i]);
 	}
+}
+
+/*
+ * window value by selected estimator as sum / n, for _lookup_co2_ppm
+ */
+static void _estimate_co2_sensor_window(adc_window_t *win, long long *sum, long long *n)
+{
+	int trim;
 
-	return percentage;
+	switch (resource_get_co2_sensor_estimator()) {
+	case CO2_ESTIMATOR_MEDIAN:	// mean of the two middle samples
+		*sum = adc_rank_select(&co2_rank, (win->bsize - 1) / 2) + adc_rank_select(&co2_rank, win->bsize / 2);
+		*n = 2;
+		break;
+	case CO2_ESTIMATOR_TRIMMED:
+		trim = win->bsize * CO2_TRIM_PERCENT / 100;
+		*sum = adc_rank_sum_smallest(&co2_rank, win->bsize - trim) - adc_rank_sum_smallest(&co2_rank, trim);
+		*n = win->bsize - 2 * trim;
+		break;
+	case CO2_ESTIMATOR_KALMAN:	// 1/256 code resolution for table interpolation
+		*sum = (long long)(co2_kalman.x * 256.);
+		*n = 256;
+		break;
+	default:
+		*sum = win->sum;
+		*n = win->bsize;
+		break;
+	}
+}
+
+/*
+ * compute co2 ppm from the sample window, aggregate thread only
+ */
+static void _aggregate_co2_sensor_value(co2_sensor_snapshot_t *snap)
+{
+	adc_window_t *win = &resource_adc_scan_channel(ADC_PIN)->window;
+	struct timespec ts;
+	long long sum, n;
+	static int debug = 0;
+
+	pthread_mutex_lock(&kalman_lock);
+	co2_kalman.q = kalman_q;
+	co2_kalman.r = kalman_r;
+	pthread_mutex_unlock(&kalman_lock);
+
+	resource_adc_window_drain(ADC_PIN);
+
+	memset(snap, 0, sizeof(*snap));
+	snap->samples = win->bsize;
+	if (win->bsize == 0) {
+		snap->ppm = -1;
+	} else {
+		_estimate_co2_sensor_window(win, &sum, &n);
+		snap->ppm = _lookup_co2_ppm(sum, n);
+		resource_adc_window_stat(ADC_PIN, &snap->average, &snap->stddev);
+	}
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	snap->timestamp = (unsigned long long)ts.tv_sec * 1000 + ts.tv_nsec / 1000000;
+
+	if (snap->ppm < 0 || snap->ppm >= 10000) {
+		if ((debug++ % 5) == 0)
+			_D("sensor: %.f (sd %.1f), volt: %.2f mV, CO2: %d ppm", snap->average, snap->stddev,
+				(snap->average * ADC_REF_VOLT) / ADC_MAX_VOLT, snap->ppm);
+	}
 }
 
 /*
@@ -169,71 +406,359 @@ int resource_update_co2_sensor_value(void)
  */
 void resource_init_co2_sensor(void)
 {
-	float zero_volts;	// measurement mutimeter voltage (mV)
+	co2_sensor_param_t param;
+
+	_get_sensor_parameter(&param);
+	pthread_mutex_lock(&ppm_lock);
+	resource_co2_mg811_init(param.zero_volts);
+	_build_co2_ppm_table();
+	pthread_mutex_unlock(&ppm_lock);
+}
+
+static int _get_co2_data_path(char *path, int len)
+{
+	char *app_data_path = NULL;
 
-	zero_volts = (float)_get_sensor_parameter(0) / 1000.0;
-	if (zero_volts == 0.0)
-		zero_volts = DEFAULT_ZERO_VOLTS;
+	app_data_path = app_get_data_path();
+	if (!app_data_path) {
+		_E("app_get_data_path() failed");
+		return -1;
+	}
+	snprintf(path, len, "%s%s", app_data_path, CO2_DATA);
+	free(app_data_path);
 
-	_init_co2_mg811_set(zero_volts/DC_GAIN, (zero_volts - DEFAULT_RANGE_VOLTS)/DC_GAIN);
+	return 0;
 }
 
 /*
- * get adc parameters
- * 0: calibration min voltage
- * 1: calibration max voltage (no used)
- * 2: notification loop count (default 100 is 1000msec delay)
+ * parameters used without co2_data
  */
-int _get_sensor_parameter(int index)
+static void _default_sensor_parameter(co2_sensor_param_t *param)
 {
-	FILE *fp;
-	char buffer[16];
-	int volts[3];
+	param->zero_volts = (int)(DEFAULT_ZERO_VOLTS * 1000);
+	param->max_volts = param->zero_volts - (int)(DEFAULT_RANGE_VOLTS * 1000);
+	param->notify_count = 0;
+	param->adc_driver[0] = '\0';
+	param->spi_backend = -1;
+	param->window_size = 0;
+	param->scan_rate = 0;
+	param->estimator = -1;
+	param->trend_window = 0;
+	param->kalman_q = 0.f;
+	param->kalman_r = 0.f;
+}
 
+/*
+ * read adc parameters from co2_data file
+ * "zero max count [driver [backend [window rate estimator trend q r]]]": calibration min voltage,
+ * calibration max voltage (no used), notification loop count (default 100 is 1000msec delay),
+ * then the co2sensorconfig values: adc chip name ("-": build default), adc_spi_backend_e,
+ * window size, scan rate, co2_estimator_e, trend window (sec) and kalman noise.
+ * fields left out or unset (-1, 0) keep their defaults, so older 3 to 5 field files still load
+ */
+static void _load_sensor_parameter(co2_sensor_param_t *param)
+{
+	FILE *fp;
+	char buffer[CO2_DATA_LINE_LEN];
 	char path[MAX_PATH_LEN];
-	char *app_data_path = NULL;
+	bool wrong = false;
 
-	app_data_path = app_get_data_path();
-	sprintf(path, "%s%s", app_data_path, CO2_DATA);
+	_default_sensor_parameter(param);
+
+	if (_get_co2_data_path(path, sizeof(path)) < 0)
+		return;
 
 	if((fp = fopen(path, "r")) == NULL) {
 		_E("Error: [%s] can't open adc data file", path);
-		if (index == 2)
-			return 0;
-		return (int)(DEFAULT_ZERO_VOLTS * 1000);
+		return;
 	}
-	fgets(buffer, 16, fp);
+	if (fgets(buffer, sizeof(buffer), fp) == NULL)
+		wrong = true;
+	else if (!strchr(buffer, '\n') && fgetc(fp) != EOF)	// cut line, files before the newline end at EOF
+		wrong = true;
+	else if (sscanf(buffer, "%d %d %d %15s %d %d %d %d %d %f %f",	// 15: CO2_ADC_DRIVER_LEN - 1
+			&param->zero_volts, &param->max_volts, &param->notify_count, param->adc_driver, &param->spi_backend,
+			&param->window_size, &param->scan_rate, &param->estimator, &param->trend_window,
+			&param->kalman_q, &param->kalman_r) < 3)
+		wrong = true;
 	fclose(fp);
-	sscanf(buffer, "%d %d %d", &volts[0], &volts[1], &volts[2]);
-	_D("get parameter: %s, zero: %d, max: %d, count: %d", buffer, volts[0], volts[1], volts[2]);
+	if (wrong) {
+		_E("Error: [%s] wrong adc data", path);
+		_default_sensor_parameter(param);
+		return;
+	}
+	if (!strcmp(param->adc_driver, "-"))
+		param->adc_driver[0] = '\0';
+	_D("get parameter: zero: %d, max: %d, count: %d, adc: %s, spi: %d", param->zero_volts, param->max_volts, param->notify_count,
+		param->adc_driver[0] ? param->adc_driver : "default", param->spi_backend);
+	_D("get parameter: window: %d, rate: %d, estimator: %d, trend: %d, kalman: %g / %g", param->window_size,
+		param->scan_rate, param->estimator, param->trend_window, param->kalman_q, param->kalman_r);
+}
 
-	free(app_data_path);
+static void _init_sensor_parameter(void)
+{
+	_load_sensor_parameter(&sensor_param[0]);
+	__atomic_store_n(&sensor_param_p, &sensor_param[0], __ATOMIC_RELEASE);
+}
 
-	return volts[index];
+/*
+ * get adc parameters, file is read only once
+ */
+static void _get_sensor_parameter(co2_sensor_param_t *param)
+{
+	pthread_once(&sensor_param_once, _init_sensor_parameter);
+	*param = *__atomic_load_n(&sensor_param_p, __ATOMIC_ACQUIRE);
 }
 
 /*
- * set adc parameters
+ * replace cached adc parameters
  */
-void resource_set_sensor_parameter(int zero_volts)
+static void _put_sensor_parameter(const co2_sensor_param_t *param)
+{
+	co2_sensor_param_t *next;
+
+	pthread_once(&sensor_param_once, _init_sensor_parameter);
+	next = (sensor_param_p == &sensor_param[0]) ? &sensor_param[1] : &sensor_param[0];
+	*next = *param;
+	__atomic_store_n(&sensor_param_p, next, __ATOMIC_RELEASE);
+}
+
+/*
+ * notify period in NOTIFY_TIME_UNIT, default for unset or too short
+ */
+static int _notify_count(const co2_sensor_param_t *param)
+{
+	return (param->notify_count < NOTIFY_TIME_MIN) ? DEFAULT_NOTIFY_TIME : param->notify_count;
+}
+
+/*
+ * write adc parameters to co2_data file
+ */
+static void _save_sensor_parameter(const co2_sensor_param_t *param)
 {
 	FILE *fp;
-	char buffer[16];
+	char buffer[CO2_DATA_LINE_LEN];
 	char path[MAX_PATH_LEN];
-	char *app_data_path = NULL;
+	int len;
 
-	app_data_path = app_get_data_path();
-	sprintf(path, "%s%s", app_data_path, CO2_DATA);
+	memset(buffer, 0, sizeof(buffer));
+	len = snprintf(buffer, sizeof(buffer), "%d %d %d %s %d %d %d %d %d %.9g %.9g\n",
+			param->zero_volts, param->max_volts, param->notify_count,
+			param->adc_driver[0] ? param->adc_driver : "-", param->spi_backend,
+			param->window_size, param->scan_rate, param->estimator, param->trend_window,
+			param->kalman_q, param->kalman_r);
+	if (len < 0 || len >= (int)sizeof(buffer)) {	// the reader would get a cut line
+		_E("ERROR: adc data too long: %d", len);
+		return;
+	}
+
+	if (_get_co2_data_path(path, sizeof(path)) < 0)
+		return;
 
 	if((fp = fopen(path, "w+")) == NULL) {
 		_E("ERROR: can't fopen file: %s", CO2_DATA);
 		return;
 	}
-	memset(buffer, 0, sizeof(buffer));
-	sprintf(buffer, "%d %d %d", zero_volts, zero_volts - (int)(DEFAULT_RANGE_VOLTS * 1000), DEFAULT_NOTIFY_TIME);
 	fputs(buffer, fp);
 	fclose(fp);
-	free(app_data_path);
+}
+
+/*
+ * set adc parameters
+ */
+void resource_set_sensor_parameter(int zero_volts)
+{
+	co2_sensor_param_t param;
+
+	pthread_mutex_lock(&sensor_param_lock);
+	_get_sensor_parameter(&param);
+	param.zero_volts = zero_volts;
+	param.max_volts = zero_volts - (int)(DEFAULT_RANGE_VOLTS * 1000);
+	if (param.notify_count == 0)
+		param.notify_count = DEFAULT_NOTIFY_TIME;
+	_put_sensor_parameter(&param);
+	_save_sensor_parameter(&param);
+	pthread_mutex_unlock(&sensor_param_lock);
+}
+
+int resource_get_co2_sensor_notify_period(void)
+{
+	co2_sensor_param_t param;
+
+	_get_sensor_parameter(&param);
+
+	return _notify_count(&param) * NOTIFY_TIME_UNIT;
+}
+
+/*
+ * adc chip in use, or the one the sampler is about to switch to
+ */
+const char *resource_get_co2_sensor_adc_driver(void)
+{
+	const adc_driver_t *driver = __atomic_load_n(&adc_driver_req, __ATOMIC_ACQUIRE);
+
+	return driver ? driver->name : resource_adc_get_driver()->name;
+}
+
+/*
+ * spi backend in use, or the one the sampler is about to reopen with
+ */
+int resource_get_co2_sensor_spi_backend(void)
+{
+	int backend = __atomic_load_n(&spi_backend_req, __ATOMIC_ACQUIRE);
+
+	return (backend >= 0) ? backend : (int)resource_adc_spi_get_backend();
+}
+
+/*
+ * sampler thread: switch to the requested adc chip and / or spi backend.
+ * the device is closed in between, so the backend can change
+ */
+static void _switch_adc_driver(void)
+{
+	const adc_driver_t *driver = __atomic_exchange_n(&adc_driver_req, NULL, __ATOMIC_ACQ_REL);
+	int backend = __atomic_exchange_n(&spi_backend_req, -1, __ATOMIC_ACQ_REL);
+	int ret;
+
+	if (driver == resource_adc_get_driver())
+		driver = NULL;
+	if (backend == (int)resource_adc_spi_get_backend())
+		backend = -1;
+	if (!driver && backend < 0)
+		return;
+
+	resource_adc_driver_fini(resource_adc_get_driver());
+	if (backend >= 0 && resource_adc_spi_set_backend(backend) < 0)
+		_E("spi backend %d not set, device still in use", backend);
+	if (driver)
+		resource_adc_set_driver(driver->name);
+	ret = resource_adc_driver_init(resource_adc_get_driver());
+	_I("adc reopened: %s, spi backend %d, init ret: %d", resource_adc_get_driver()->name,
+		(int)resource_adc_spi_get_backend(), ret);
+}
+
+int resource_get_co2_sensor_window(void)
+{
+	return resource_adc_window_get_size(ADC_PIN);
+}
+
+void resource_get_co2_sensor_config(co2_sensor_config_t *cfg)
+{
+	cfg->window_size = resource_get_co2_sensor_window();
+	cfg->scan_rate = (int)resource_adc_scan_get_rate();
+	cfg->estimator = resource_get_co2_sensor_estimator();
+	cfg->notify_period = resource_get_co2_sensor_notify_period();
+	snprintf(cfg->adc_driver, sizeof(cfg->adc_driver), "%s", resource_get_co2_sensor_adc_driver());
+	cfg->spi_backend = resource_get_co2_sensor_spi_backend();
+	cfg->trend_window = resource_get_co2_sensor_trend_window();
+	resource_get_co2_sensor_kalman(&cfg->kalman_q, &cfg->kalman_r);
+}
+
+/*
+ * check every config value, nothing is applied if one is wrong
+ */
+static int _check_co2_sensor_config(const co2_sensor_config_t *cfg)
+{
+	if (cfg->window_size < ADC_MIN_SIZE || cfg->window_size > ADC_MAX_SIZE) {
+		_E("wrong window size: %d", cfg->window_size);
+		return -1;
+	}
+	if (cfg->scan_rate <= 0 || cfg->scan_rate > ADC_SCAN_RATE_MAX) {
+		_E("wrong scan rate: %d", cfg->scan_rate);
+		return -1;
+	}
+	if (cfg->estimator < 0 || cfg->estimator >= CO2_ESTIMATOR_MAX) {
+		_E("wrong estimator: %d", cfg->estimator);
+		return -1;
+	}
+	if (cfg->notify_period < NOTIFY_TIME_MIN * NOTIFY_TIME_UNIT || cfg->notify_period > NOTIFY_TIME_MAX * NOTIFY_TIME_UNIT) {
+		_E("wrong notify period: %d", cfg->notify_period);
+		return -1;
+	}
+	if (!resource_adc_find_driver(cfg->adc_driver)) {
+		_E("wrong adc driver: %s", cfg->adc_driver);
+		return -1;
+	}
+	if (cfg->spi_backend < 0 || cfg->spi_backend >= ADC_SPI_BACKEND_MAX) {
+		_E("wrong spi backend: %d", cfg->spi_backend);
+		return -1;
+	}
+	if (_co2_trend_points(cfg->trend_window) < 0) {
+		_E("wrong trend window: %d", cfg->trend_window);
+		return -1;
+	}
+	if (!(cfg->kalman_q > 0.f) || !(cfg->kalman_r > 0.f)) {
+		_E("wrong kalman noise: %g / %g", cfg->kalman_q, cfg->kalman_r);
+		return -1;
+	}
+
+	return 0;
+}
+
+/*
+ * check, apply and save all co2sensorconfig values together. the window
+ * restarts if its size changed, the notify period restarts from now and the
+ * sampler thread switches adc chip or spi backend between two scans
+ */
+int resource_set_co2_sensor_config(const co2_sensor_config_t *cfg)
+{
+	co2_sensor_param_t param;
+	int notify_count = cfg->notify_period / NOTIFY_TIME_UNIT;
+	int notify_changed;
+
+	if (_check_co2_sensor_config(cfg) < 0)
+		return -1;
+
+	pthread_mutex_lock(&sensor_param_lock);
+	_get_sensor_parameter(&param);
+	notify_changed = (notify_count != _notify_count(&param));
+	param.notify_count = notify_count;
+	snprintf(param.adc_driver, sizeof(param.adc_driver), "%s", cfg->adc_driver);
+	param.spi_backend = cfg->spi_backend;
+	param.window_size = cfg->window_size;
+	param.scan_rate = cfg->scan_rate;
+	param.estimator = cfg->estimator;
+	param.trend_window = cfg->trend_window;
+	param.kalman_q = cfg->kalman_q;
+	param.kalman_r = cfg->kalman_r;
+	_put_sensor_parameter(&param);
+	_save_sensor_parameter(&param);
+
+	resource_adc_window_set_size(ADC_PIN, cfg->window_size);
+	resource_adc_scan_set_rate(cfg->scan_rate);
+	resource_set_co2_sensor_estimator(cfg->estimator);
+	resource_set_co2_sensor_trend_window(cfg->trend_window);
+	resource_set_co2_sensor_kalman(cfg->kalman_q, cfg->kalman_r);
+	__atomic_store_n(&adc_driver_req, resource_adc_find_driver(cfg->adc_driver), __ATOMIC_RELEASE);
+	__atomic_store_n(&spi_backend_req, cfg->spi_backend, __ATOMIC_RELEASE);
+	pthread_mutex_unlock(&sensor_param_lock);
+
+	if (notify_changed)
+		resource_co2_sensor_notify_event(NOTIFY_EVENT_CONFIG);	// restart the running period
+
+	return 0;
+}
+
+/*
+ * sampler thread, before the first init: co2sensorconfig values saved in co2_data
+ */
+static void _load_co2_sensor_config(const co2_sensor_param_t *param)
+{
+	if (param->adc_driver[0])
+		resource_adc_set_driver(param->adc_driver);
+	if (param->spi_backend >= 0)
+		resource_adc_spi_set_backend(param->spi_backend);
+	if (param->window_size && resource_adc_window_set_size(ADC_PIN, param->window_size) < 0)
+		_E("wrong saved window size: %d", param->window_size);
+	if (param->scan_rate > 0)
+		resource_adc_scan_set_rate(param->scan_rate);
+	if (param->estimator >= 0 && resource_set_co2_sensor_estimator(param->estimator) < 0)
+		_E("wrong saved estimator: %d", param->estimator);
+	if (param->trend_window && resource_set_co2_sensor_trend_window(param->trend_window) < 0)
+		_E("wrong saved trend window: %d", param->trend_window);
+	if ((param->kalman_q != 0.f || param->kalman_r != 0.f)
+		&& resource_set_co2_sensor_kalman(param->kalman_q, param->kalman_r) < 0)
+		_E("wrong saved kalman noise: %g / %g", param->kalman_q, param->kalman_r);
 }
 
 /*
@@ -241,15 +766,17 @@ void resource_set_sensor_parameter(int zero_volts)
  */
 int resource_get_co2_sensor_parameter(void)
 {
-	int param = _get_sensor_parameter(0);
+	co2_sensor_param_t param;
+
+	_get_sensor_parameter(&param);
 
-	return param;
+	return param.zero_volts;
 }
 
 /*
  * notify sensor value to cloud
  */
-static int notify_sensor_value(void)
+static int notify_sensor_value(co2_sensor_snapshot_t *snap)
 {
 	int error = SMARTTHINGS_RESOURCE_ERROR_NONE;
 
@@ -262,13 +789,34 @@ static int notify_sensor_value(void)
 		return error;
 	}
 
-	error = smartthings_payload_set_int(resp_payload, PROP_AIRQUALITY, g_co2_sensor_value);
+	error = smartthings_payload_set_int(resp_payload, PROP_AIRQUALITY, snap->ppm);
 	if (error != SMARTTHINGS_RESOURCE_ERROR_NONE) {
 		_E("smartthings_payload_set_int() failed, [%d]", error);
 		smartthings_payload_destroy(resp_payload);
 		return error;
 	}
 
+	error = smartthings_payload_set_double(resp_payload, PROP_TREND, snap->trend);
+	if (error != SMARTTHINGS_RESOURCE_ERROR_NONE) {
+		_E("smartthings_payload_set_double() failed, [%d]", error);
+		smartthings_payload_destroy(resp_payload);
+		return error;
+	}
+
+	if (snap->percentile[0] >= 0.f) {
+		double percentile[CO2_PERCENTILES];
+		int i;
+
+		for (i = 0; i < CO2_PERCENTILES; i++)
+			percentile[i] = snap->percentile[i];
+		error = smartthings_payload_set_double_array(resp_payload, PROP_PERCENTILES, percentile, CO2_PERCENTILES);
+		if (error != SMARTTHINGS_RESOURCE_ERROR_NONE) {
+			_E("smartthings_payload_set_double_array() failed, [%d]", error);
+			smartthings_payload_destroy(resp_payload);
+			return error;
+		}
+	}
+
 	error = smartthings_resource_notify(st_handle, RES_CAPABILITY_AIRQUALITYSENSOR, resp_payload);
 	if (error != SMARTTHINGS_RESOURCE_ERROR_NONE) {
 		_E("smartthings_resource_notify() failed, [%d]", error);
@@ -284,86 +832,446 @@ static int notify_sensor_value(void)
 	return error;
 }
 
+/*
+ * conds are statically initialized on CLOCK_REALTIME, switch both to
+ * CLOCK_MONOTONIC before the first wait or signal
+ */
+static void _init_event_cond(void)
+{
+	pthread_condattr_t attr;
+
+	pthread_condattr_init(&attr);
+	pthread_condattr_setclock(&attr, CLOCK_MONOTONIC);
+	pthread_cond_destroy(&notify_ev.cond);
+	pthread_cond_destroy(&aggregate_ev.cond);
+	pthread_cond_init(&notify_ev.cond, &attr);
+	pthread_cond_init(&aggregate_ev.cond, &attr);
+	pthread_condattr_destroy(&attr);
+}
+
+static void _post_event(co2_event_t *ev, unsigned int event)
+{
+	pthread_once(&event_once, _init_event_cond);
+
+	pthread_mutex_lock(&ev->lock);
+	ev->event |= event;
+	pthread_cond_signal(&ev->cond);
+	pthread_mutex_unlock(&ev->lock);
+}
+
+/*
+ * wait for event bits until deadline, returns and clears the pending bits.
+ * *timedout is set when the deadline passed without event
+ */
+static unsigned int _wait_event(co2_event_t *ev, const struct timespec *deadline, int *timedout)
+{
+	unsigned int event;
+	int ret = 0;
+
+	pthread_once(&event_once, _init_event_cond);
+
+	pthread_mutex_lock(&ev->lock);
+	while (!ev->event && !thread_done && ret != ETIMEDOUT)
+		ret = pthread_cond_timedwait(&ev->cond, &ev->lock, deadline);
+	event = ev->event;
+	ev->event = 0;
+	pthread_mutex_unlock(&ev->lock);
+
+	*timedout = (ret == ETIMEDOUT);
+
+	return event;
+}
+
+/*
+ * wake up notify thread, event is NOTIFY_EVENT_* bits
+ */
+void resource_co2_sensor_notify_event(unsigned int event)
+{
+	_post_event(&notify_ev, event);
+}
+
+/*
+ * wake up all sensor threads waiting for events, used on exit
+ */
+void resource_co2_sensor_wakeup(void)
+{
+	_post_event(&aggregate_ev, 0);
+	_post_event(&notify_ev, 0);
+}
+
+/*
+ * sampler callback: wake aggregate thread each time a block of new samples is in
+ */
+static void _sensor_scan_cb(void *user_data)
+{
+	unsigned int *block_head = user_data;
+	unsigned int head;
+
+	if (__atomic_load_n(&adc_driver_req, __ATOMIC_RELAXED) || __atomic_load_n(&spi_backend_req, __ATOMIC_RELAXED) >= 0)
+		_switch_adc_driver();
+
+	head = adc_ring_head(&resource_adc_scan_channel(ADC_PIN)->ring);
+
+	if (head - *block_head >= (unsigned int)(AGGREGATE_SAMPLES * resource_adc_scan_get_oversample())) {
+		*block_head = head;
+		_post_event(&aggregate_ev, AGGREGATE_EVENT_BLOCK);
+	}
+}
+
 /*
  * main thread function to get sensor data
  */
 void *thread_sensor_main(void *arg)
 {
 	int ret = 0;
-	int pin = ADC_PIN;
-	int err_count = 0;
-	short sensor_value;
-	co2_sensor_data_t *sensorp = &co2_sensor;
+	unsigned int block_head = 0;
+	co2_sensor_param_t param;
 
 	_D("%s starting...\n", __func__);
 
-	memset((void *)sensorp, 0, sizeof(co2_sensor_data_t));
 	resource_init_co2_sensor();
+	resource_adc_scan_set_channels(ADC_SCAN_CHANNELS);
+
+	_get_sensor_parameter(&param);
+	_load_co2_sensor_config(&param);
+
+	ret = resource_adc_driver_init(resource_adc_get_driver());
+	_D("%s init ret: %d", resource_adc_get_driver()->name, ret);
+
+	resource_adc_scan_loop(&thread_done, _sensor_scan_cb, &block_head);
+	_D("%s exiting...\n", __func__);
+	pthread_exit((void *) 0);
+}
+
+static void _timespec_add_ms(struct timespec *ts, int msec)
+{
+	ts->tv_sec += msec / 1000;
+	ts->tv_nsec += (msec % 1000) * 1000000L;
+	if (ts->tv_nsec >= 1000000000L) {
+		ts->tv_sec++;
+		ts->tv_nsec -= 1000000000L;
+	}
+}
+
+/*
+ * ppm of the samples that entered the window since the last call, -1 if none.
+ * unlike the window value, a step shows up within one block instead of being
+ * spread over the whole window
+ */
+static int _co2_block_ppm(co2_block_t *blk)
+{
+	int ppm = blk->n ? _lookup_co2_ppm(blk->sum, blk->n) : -1;
 
-	ret = resource_adc_mcp3008_init();
-	_D("resource_adc_mcp3008_init ret: %d", ret);
+	blk->sum = 0;
+	blk->n = 0;
 
-	while (true)
-	{
+	return ppm;
+}
+
+/*
+ * feed one block ppm value, returns 1 when a step change is detected.
+ * the reference level is frozen while either sum is armed, so a slow rise
+ * can't drag it along. a sustained step of d > CUSUM_DRIFT ppm trips after
+ * CUSUM_THRESHOLD / (d - CUSUM_DRIFT) blocks, e.g. 50 ppm in 8 blocks (~2 sec),
+ * 125 ppm in 2. steps up to CUSUM_DRIFT are not detected.
+ */
+static int _co2_cusum_update(co2_cusum_t *cs, int ppm)
+{
+	int diff;
+
+	if (!cs->started) {
+		cs->started = 1;
+		cs->mean = ppm << 8;
+		cs->s_hi = cs->s_lo = 0;
+		return 0;
+	}
+
+	diff = ppm - (cs->mean >> 8);
+	cs->s_hi = (cs->s_hi + diff - CUSUM_DRIFT > 0) ? cs->s_hi + diff - CUSUM_DRIFT : 0;
+	cs->s_lo = (cs->s_lo - diff - CUSUM_DRIFT > 0) ? cs->s_lo - diff - CUSUM_DRIFT : 0;
+
+	if (cs->s_hi > CUSUM_THRESHOLD || cs->s_lo > CUSUM_THRESHOLD) {
+		_D("co2 step: %d ppm from %d ppm (+%d/-%d)", ppm, cs->mean >> 8, cs->s_hi, cs->s_lo);
+		cs->mean = ppm << 8;	// restart from the new level
+		cs->s_hi = cs->s_lo = 0;
+		return 1;
+	}
+	if (cs->s_hi == 0 && cs->s_lo == 0)
+		cs->mean += ((ppm << 8) - cs->mean) >> CUSUM_MEAN_SHIFT;
+
+	return 0;
+}
+
+/*
+ * trend window (sec) in whole points of TREND_INTERVAL_MS, -1 if out of range
+ */
+static int _co2_trend_points(int sec)
+{
+	int points = sec / (TREND_INTERVAL_MS / 1000);
+
+	if (sec < 0 || points < 2 || points > CO2_TREND_POINTS_MAX)
+		return -1;
+
+	return points;
+}
+
+/*
+ * set trend window (sec), rounded down to whole points of TREND_INTERVAL_MS.
+ * the trend starts over with the next point
+ */
+int resource_set_co2_sensor_trend_window(int sec)
+{
+	int points = _co2_trend_points(sec);
+
+	if (points < 0)
+		return -1;
+	__atomic_store_n(&trend_points, points, __ATOMIC_RELAXED);
+	_D("co2 trend window: %d points", points);
+
+	return 0;
+}
+
+int resource_get_co2_sensor_trend_window(void)
+{
+	return __atomic_load_n(&trend_points, __ATOMIC_RELAXED) * (TREND_INTERVAL_MS / 1000);
+}
+
+/*
+ * add one point, O(1): when the oldest point leaves, every other index drops by 1
+ */
+static void _co2_trend_put(co2_trend_t *tr, int ppm)
+{
+	int points = __atomic_load_n(&trend_points, __ATOMIC_RELAXED);
+
+	if (points != tr->points) {	// new window length, start over
+		tr->points = points;
+		tr->n = tr->index = 0;
+		tr->sum_y = tr->sum_iy = 0;
+	}
+
+	if (tr->n == tr->points) {
+		int oldest = tr->y[tr->index];
+
+		tr->sum_y -= oldest;
+		tr->sum_iy -= tr->sum_y;
+		tr->n--;
+	}
+	tr->y[tr->index] = ppm;
+	tr->sum_iy += (long long)tr->n * ppm;
+	tr->sum_y += ppm;
+	tr->n++;
+	if (++tr->index >= tr->points)
+		tr->index = 0;
+}
+
+/*
+ * slope in ppm per minute, 0 until two points are in
+ */
+static float _co2_trend_slope(co2_trend_t *tr)
+{
+	long long n = tr->n;
+	long long sum_i = n * (n - 1) / 2;
+	long long sum_ii = (n - 1) * n * (2 * n - 1) / 6;
+	long long den = n * sum_ii - sum_i * sum_i;
+
+	if (n < 2 || den == 0)
+		return 0.f;
+
+	return (float)(n * tr->sum_iy - sum_i * tr->sum_y) / (float)den * (60000.f / TREND_INTERVAL_MS);
+}
+
+static unsigned long long _monotonic_ns(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (unsigned long long)ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+/*
+ * account one aggregate round, publish rates once per DIAG_PERIOD_MS
+ */
+static void _co2_diag_update(co2_diag_acc_t *acc, unsigned long long now, unsigned int head, unsigned long long estimate_ns)
+{
+	adc_window_t *win = &resource_adc_scan_channel(ADC_PIN)->window;
+	adc_spi_stat_t spi;
+	adc_sched_stat_t sched;
+	unsigned long long frames;
+	float period;
+
+	acc->estimate_ns += estimate_ns;
+	acc->estimates++;
+	if (now - acc->start < DIAG_PERIOD_MS)
+		return;
+
+	resource_adc_spi_get_stat(&spi);
+	resource_adc_scan_get_sched_stat(&sched);
+	if (spi.frames < acc->frames)	// device reopened
+		acc->frames = acc->bad_frames = 0;
+	frames = spi.frames - acc->frames;
+	period = (float)(now - acc->start) / 1000.f;
+
+	pthread_mutex_lock(&diag_lock);
+	co2_diag.sample_rate = (float)(head - acc->head) / period;
+	co2_diag.spi_error_rate = frames ? (float)(spi.bad_frames - acc->bad_frames) / (float)frames : 0.f;
+	co2_diag.window_fill = win->bsize;
+	co2_diag.window_size = win->size;
+	co2_diag.estimate_us = (float)acc->estimate_ns / 1000.f / (float)acc->estimates;
+	co2_diag.missed = sched.missed;
+	pthread_mutex_unlock(&diag_lock);
+
+	acc->start = now;
+	acc->head = head;
+	acc->frames = spi.frames;
+	acc->bad_frames = spi.bad_frames;
+	acc->estimate_ns = 0;
+	acc->estimates = 0;
+}
+
+void resource_get_co2_sensor_diag(co2_sensor_diag_t *diag)
+{
+	if (!diag)
+		return;
+
+	pthread_mutex_lock(&diag_lock);
+	*diag = co2_diag;
+	pthread_mutex_unlock(&diag_lock);
+}
+
+/*
+ * aggregate thread, turns new samples into a published co2 value
+ */
+void *thread_sensor_aggregate(void *arg)
+{
+	co2_sensor_snapshot_t snap;
+	struct timespec deadline;
+	float percentile[CO2_PERCENTILES];
+	unsigned long long percentile_next;
+	unsigned long long start_ns;
+	co2_diag_acc_t diag_acc = { 0, };
+	unsigned int head, window_head = 0;
+	int timedout = 0;
+	int block_ppm;
+	int was_alarm = 0, is_alarm;
+
+	_D("%s starting...\n", __func__);
+
+	resource_adc_window_set_rank(ADC_PIN, &co2_rank);
+	resource_adc_window_set_sample_cb(ADC_PIN, _co2_sample_update, NULL);
+	_co2_percentile_roll(percentile);
+	diag_acc.start = _monotonic_ns() / 1000000;
+	percentile_next = diag_acc.start + PERCENTILE_PERIOD_MS;
+
+	while (true) {
+		clock_gettime(CLOCK_MONOTONIC, &deadline);
+		_timespec_add_ms(&deadline, AGGREGATE_TIMEOUT);
+		_wait_event(&aggregate_ev, &deadline, &timedout);
 		if (thread_done) break;
 
-		sensor_value = resource_get_co2_sensor_analog(pin);
-		if (sensor_value >= 0)
-		{
-			MUTEX_LOCK;
-			sensorp->sensor_value[sensorp->index++] = sensor_value;
-			if (sensorp->index >= ADC_MAX_SIZE)
-				sensorp->index = 0;
-			if (sensorp->bsize < ADC_MAX_SIZE)
-				sensorp->bsize++;
-			sensorp->count++;
-			MUTEX_UNLOCK;
-			err_count = 0;
-			usleep(10);				// 10usec
+		head = adc_ring_head(&resource_adc_scan_channel(ADC_PIN)->ring);
+		start_ns = _monotonic_ns();
+		_aggregate_co2_sensor_value(&snap);
+		_co2_diag_update(&diag_acc, snap.timestamp, head, _monotonic_ns() - start_ns);
+		if (__atomic_exchange_n(&spi_dump_request, 0, __ATOMIC_ACQ_REL))
+			resource_adc_spi_dump();
+		block_ppm = _co2_block_ppm(&co2_block);
+		if (snap.ppm >= 0 && snap.timestamp >= co2_trend.next) {
+			co2_trend.next = snap.timestamp + TREND_INTERVAL_MS;
+			_co2_trend_put(&co2_trend, snap.ppm);
 		}
-		else
-		{
-			if (++err_count >= 100)
-			{
-				memset((void *)sensorp, 0, sizeof(co2_sensor_data_t));
-			}
-			usleep(10 * 1000);		// 10msec
+		snap.trend = _co2_trend_slope(&co2_trend);
+		_co2_percentile_add(block_ppm);
+		if (snap.timestamp >= percentile_next) {
+			percentile_next += PERCENTILE_PERIOD_MS;
+			if (percentile_next <= snap.timestamp)	// stalled, realign
+				percentile_next = snap.timestamp + PERCENTILE_PERIOD_MS;
+			_co2_percentile_roll(percentile);
+		}
+		memcpy(snap.percentile, percentile, sizeof(snap.percentile));
+		_publish_co2_snapshot(&snap);
+
+		if (head - window_head >= (unsigned int)(resource_get_co2_sensor_window() * resource_adc_scan_get_oversample())) {
+			window_head = head;
+			resource_co2_sensor_notify_event(NOTIFY_EVENT_WINDOW);
+		}
+
+		if (block_ppm >= 0 && _co2_cusum_update(&co2_cusum, block_ppm)) {
+			__atomic_store_n(&co2_step_ppm, block_ppm, __ATOMIC_RELEASE);
+			resource_co2_sensor_notify_event(NOTIFY_EVENT_STEP);
+		}
+
+		if (snap.ppm < 0)
+			continue;
+
+		is_alarm = (snap.ppm >= (was_alarm ? CO2_ALARM_CLEAR_PPM : CO2_ALARM_PPM));
+		if (is_alarm != was_alarm) {
+			was_alarm = is_alarm;
+			resource_co2_sensor_notify_event(NOTIFY_EVENT_ALARM);
 		}
 	}
 	_D("%s exiting...\n", __func__);
 	pthread_exit((void *) 0);
 }
 
+/*
+ * notify thread, sleeps until the notify period ends or an event is posted
+ */
 void *thread_sensor_notify(void *arg)
-			{
+{
 	int count = 0;
-	int nloop = 0;
+	int timedout = 0;
+	unsigned int event;
+	unsigned int head, last_head = 0;
+	struct timespec deadline, now;
+	co2_sensor_snapshot_t snap;
+	co2_sensor_param_t param;
+
+	_get_sensor_parameter(&param);
+	count = _notify_count(&param);
+
+	clock_gettime(CLOCK_MONOTONIC, &deadline);
+	_timespec_add_ms(&deadline, count * NOTIFY_TIME_UNIT);
 
-	count = _get_sensor_parameter(2);
-	if (count < 10)
-		count = DEFAULT_NOTIFY_TIME;
 	while (true) {
+		event = _wait_event(&notify_ev, &deadline, &timedout);
 		if (thread_done) break;
 
-		if (nloop++ >= count) {
-			nloop = 0;
-			// notify sensor value to server
-			co2_sensor_data_t *sensorp = &co2_sensor;
-
-			if (g_co2_sensor_value > 0 && g_co2_sensor_value < 10000)
-				_D("CO2 value: %d, count: %d", g_co2_sensor_value, sensorp->count);
+		if (timedout) {	// periodic notify, next period starts from this deadline
+			_get_sensor_parameter(&param);
+			count = _notify_count(&param);
+			clock_gettime(CLOCK_MONOTONIC, &now);
+			_timespec_add_ms(&deadline, count * NOTIFY_TIME_UNIT);
+			if (deadline.tv_sec < now.tv_sec
+				|| (deadline.tv_sec == now.tv_sec && deadline.tv_nsec < now.tv_nsec)) {
+				deadline = now;	// fell behind, don't burst
+				_timespec_add_ms(&deadline, count * NOTIFY_TIME_UNIT);
+			}
+		} else if (event & NOTIFY_EVENT_CONFIG) {	// new period, counted from now
+			_get_sensor_parameter(&param);
+			count = _notify_count(&param);
+			clock_gettime(CLOCK_MONOTONIC, &deadline);
+			_timespec_add_ms(&deadline, count * NOTIFY_TIME_UNIT);
+			event &= ~NOTIFY_EVENT_CONFIG;
+		}
+		if (!timedout && !event)
+			continue;
 
-			MUTEX_LOCK;
-			sensorp->count = 0;
-			MUTEX_UNLOCK;
+		// notify sensor value to server
+		resource_get_co2_sensor_snapshot(&snap);
+		if (event & NOTIFY_EVENT_STEP)	// window value still lags the step, send the new level
+			snap.ppm = __atomic_load_n(&co2_step_ppm, __ATOMIC_ACQUIRE);
+		head = adc_ring_head(&resource_adc_scan_channel(ADC_PIN)->ring);
+		if (snap.ppm > 0 && snap.ppm < 10000)
+			_D("CO2 value: %d, seq: %u, count: %u, event: 0x%x", snap.ppm, snap.seq, head - last_head, event);
+		last_head = head;
 
-			if (g_switch_is_on) {
-				notify_sensor_value();
-			}
+		if (g_switch_is_on && notify_sensor_value(&snap) == SMARTTHINGS_RESOURCE_ERROR_NONE) {
+			clock_gettime(CLOCK_REALTIME, &now);
+			pthread_mutex_lock(&diag_lock);
+			co2_diag.last_notify = (unsigned long long)now.tv_sec * 1000 + now.tv_nsec / 1000000;
+			pthread_mutex_unlock(&diag_lock);
 		}
-		usleep(10 * 1000);		// 10msec
 	}
 	_D("%s exiting...\n", __func__);
 	pthread_exit((void *) 0);
 }
-
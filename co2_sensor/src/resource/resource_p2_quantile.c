@@ -0,0 +1,127 @@
+/*
+ * Copyright (c) 2018 Samsung Electronics Co., Ltd.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an AS IS BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <string.h>
+#include "resource/resource_p2_quantile.h"
+
+/*
+ * P-square algorithm (Jain & Chlamtac): five markers track the minimum,
+ * p/2, p, (1+p)/2 quantiles and the maximum. each value moves the markers
+ * by at most one position and adjusts their heights with a piecewise
+ * parabolic fit, so no value is ever stored.
+ */
+
+void p2_quantile_init(p2_quantile_t *p2, float p)
+{
+	memset(p2, 0, sizeof(*p2));
+	p2->p = p;
+}
+
+static void _p2_sort_first(p2_quantile_t *p2)
+{
+	int i, j;
+	float x;
+
+	for (i = 1; i < p2->count; i++) {
+		x = p2->height[i];
+		for (j = i; j > 0 && p2->height[j - 1] > x; j--)
+			p2->height[j] = p2->height[j - 1];
+		p2->height[j] = x;
+	}
+}
+
+static float _p2_parabolic(p2_quantile_t *p2, int i, int d)
+{
+	float *q = p2->height;
+	int *n = p2->pos;
+
+	return q[i] + (float)d / (n[i + 1] - n[i - 1]) *
+		((n[i] - n[i - 1] + d) * (q[i + 1] - q[i]) / (n[i + 1] - n[i]) +
+		 (n[i + 1] - n[i] - d) * (q[i] - q[i - 1]) / (n[i] - n[i - 1]));
+}
+
+void p2_quantile_add(p2_quantile_t *p2, float x)
+{
+	float *q = p2->height;
+	int *n = p2->pos;
+	float p = p2->p;
+	float dn[P2_MARKERS] = { 0.f, p / 2.f, p, (1.f + p) / 2.f, 1.f };
+	float d, qp;
+	int i, k, s;
+
+	if (p2->count < P2_MARKERS) {	// first values are the initial markers
+		q[p2->count++] = x;
+		if (p2->count == P2_MARKERS) {
+			_p2_sort_first(p2);
+			for (i = 0; i < P2_MARKERS; i++)
+				n[i] = i;
+			p2->want[0] = 0.f;
+			p2->want[1] = 2.f * p;
+			p2->want[2] = 4.f * p;
+			p2->want[3] = 2.f + 2.f * p;
+			p2->want[4] = 4.f;
+		}
+		return;
+	}
+	p2->count++;
+
+	if (x < q[0]) {
+		q[0] = x;
+		k = 0;
+	} else if (x >= q[4]) {
+		q[4] = x;
+		k = 3;
+	} else {
+		for (k = 0; k < 3 && x >= q[k + 1]; k++)
+			;
+	}
+
+	for (i = k + 1; i < P2_MARKERS; i++)
+		n[i]++;
+	for (i = 0; i < P2_MARKERS; i++)
+		p2->want[i] += dn[i];
+
+	for (i = 1; i < P2_MARKERS - 1; i++) {
+		d = p2->want[i] - n[i];
+		if ((d >= 1.f && n[i + 1] - n[i] > 1) || (d <= -1.f && n[i - 1] - n[i] < -1)) {
+			s = (d > 0.f) ? 1 : -1;
+			qp = _p2_parabolic(p2, i, s);
+			if (q[i - 1] < qp && qp < q[i + 1])
+				q[i] = qp;
+			else
+				q[i] += s * (q[i + s] - q[i]) / (n[i + s] - n[i]);
+			n[i] += s;
+		}
+	}
+}
+
+/*
+ * current estimate, exact while fewer than 5 values were seen (0 if none)
+ */
+float p2_quantile_get(p2_quantile_t *p2)
+{
+	int i;
+
+	if (p2->count >= P2_MARKERS)
+		return p2->height[2];
+	if (p2->count == 0)
+		return 0.f;
+
+	_p2_sort_first(p2);
+	i = (int)(p2->p * (p2->count - 1) + 0.5f);
+
+	return p2->height[i];
+}
@@ -0,0 +1,67 @@
+/*
+ * Copyright (c) 2018 Samsung Electronics Co., Ltd.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an AS IS BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/*
+ * host test: integer only mg811 conversion (CO2_FIXED_POINT) against the
+ * float one, every adc code 0 to 4096 for zero points 2000 to 3300 mV.
+ * ppm may differ by 1, range decisions (-1, 10000) must match.
+ *
+ * co2_sensor$ gcc -DCO2_MG811_BOTH -Iinc -o test_co2_mg811 \
+ *         test/test_co2_mg811.c src/resource/resource_co2_mg811.c -lm
+ * co2_sensor$ ./test_co2_mg811
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include "resource/resource_co2_mg811.h"
+
+#define ZERO_MV_MIN		2000
+#define ZERO_MV_MAX		3300
+#define ZERO_MV_STEP	50
+#define PPM_TOLERANCE	1
+
+static int _is_range(int ppm)
+{
+	return ppm == -1 || ppm == 10000;
+}
+
+int main(void)
+{
+	int zero_mv, code;
+	int fl, fx;
+	int count = 0, differ = 0, failed = 0;
+
+	for (zero_mv = ZERO_MV_MIN; zero_mv <= ZERO_MV_MAX; zero_mv += ZERO_MV_STEP) {
+		resource_co2_mg811_init_float(zero_mv);
+		resource_co2_mg811_init_fixed(zero_mv);
+		for (code = 0; code < CO2_MG811_CODES; code++) {
+			fl = resource_co2_mg811_ppm_float(code);
+			fx = resource_co2_mg811_ppm_fixed(code);
+			count++;
+			if (fl == fx)
+				continue;
+			differ++;
+			if (_is_range(fl) || _is_range(fx) || abs(fl - fx) > PPM_TOLERANCE) {
+				printf("FAIL zero %d mV code %d: float %d fixed %d\n", zero_mv, code, fl, fx);
+				failed++;
+			}
+		}
+	}
+
+	printf("%d of %d conversions differ, %d out of tolerance\n", differ, count, failed);
+
+	return failed ? EXIT_FAILURE : EXIT_SUCCESS;
+}
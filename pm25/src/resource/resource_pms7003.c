@@ -15,6 +15,7 @@
  */
 
 #include <stdint.h>
+#include <string.h>
 #include <unistd.h>
 #include <peripheral_io.h>
 #include "resource/resource_pms7003.h"
@@ -49,12 +50,16 @@
 #define UART_PORT_SDTA7D		5	// SDTA7D : UART6
 #define MAX_FRAME_LEN			32
 
-int incoming_byte = 0;          // for incoming serial data
-char frame_buf[MAX_FRAME_LEN];  // for save pms7003 protocol data
-int byte_position = 0;          // next byte position in frame_buf
-int frame_len = MAX_FRAME_LEN;  // length of frame
-bool in_frame = false;          // to check start character
-unsigned int calc_checksum = 0; // to save calculated checksum value
+#define FRAME_START_CHAR1		0x42
+#define FRAME_START_CHAR2		0x4D
+#define FRAME_DATA_LEN			(MAX_FRAME_LEN - 4)	// length field : 2 x 13 + 2
+#define UART_RX_BUF_SIZE		256	// bytes buffered between reads, several frames
+
+#define FRAME_WORD(p)			((unsigned int)((p)[0] << 8) | (p)[1])	// big endian 2 BYTE
+
+// bytes read from UART but not yet parsed, the oldest byte at rx_buf[0]
+static uint8_t rx_buf[UART_RX_BUF_SIZE];
+static unsigned int rx_len = 0;
 
 // DATA STRUCTURE FOR PMS7003 PROTOCOL
 static _pms7003_protocol_t pms7003_protocol;
@@ -190,27 +195,140 @@ void resource_pms7003_fini(void)
 		// Closes the UART slave device
 		peripheral_uart_close(g_uart_h);
 		initialized = false;
+		rx_len = 0;
 		g_uart_h = NULL;
 	}
 }
 
 /*
- * read sensor data from PMS7003 and format
+ * read what the UART has buffered, up to max bytes, without waiting.
+ * peripheral_uart_read() returns only an error code: PERIPHERAL_ERROR_NONE
+ * when all requested bytes were read, PERIPHERAL_ERROR_TRY_AGAIN when none
+ * were ready, and an error after a short read whose bytes are already taken
+ * from the port. only a one byte read reports exactly what it got, so the
+ * port is drained a byte at a time until it has nothing left.
+ * returns number of bytes read, 0 if no data, -1 on error
  */
-bool resource_pms7003_read(void)
+static int _uart_read_available(uint8_t *data, uint32_t max)
 {
-	uint8_t data;
-	bool packet_received = false;
-	calc_checksum = 0;
+	uint32_t nread = 0;
+	int ret;
 
-	// clear frame buffer
-	memset(frame_buf, 0, MAX_FRAME_LEN);
+	if (g_uart_h == NULL || max == 0)
+		return -1;
 
-	// clear pms7003_protocol structure
-	memset(&pms7003_protocol, 0, sizeof(_pms7003_protocol_t));
+	while (nread < max) {
+		ret = peripheral_uart_read(g_uart_h, data + nread, 1);
+		if (ret == PERIPHERAL_ERROR_NONE) {
+			nread++;
+			continue;
+		}
+		if (ret == PERIPHERAL_ERROR_TRY_AGAIN)
+			break;
+
+		_E("UART read failed, ret [%d]", ret);
+		return nread ? (int)nread : -1;
+	}
+
+	return nread;
+}
+
+/*
+ * decode a complete frame in place
+ */
+static void _pms7003_parse(const uint8_t *frame, _pms7003_protocol_t *protocol)
+{
+	protocol->frame_header[0] = frame[0];
+	protocol->frame_header[1] = frame[1];
+	protocol->frame_len = FRAME_WORD(frame + 2);
+	protocol->standard_particle.PM1_0 = FRAME_WORD(frame + 4);
+	protocol->standard_particle.PM2_5 = FRAME_WORD(frame + 6);
+	protocol->standard_particle.PM10 = FRAME_WORD(frame + 8);
+	protocol->atmospheric_env.PM1_0 = FRAME_WORD(frame + 10);
+	protocol->atmospheric_env.PM2_5 = FRAME_WORD(frame + 12);
+	protocol->atmospheric_env.PM10 = FRAME_WORD(frame + 14);
+	protocol->checksum = FRAME_WORD(frame + MAX_FRAME_LEN - 2);
+}
+
+/*
+ * Checksum : Check code = START_CHAR1 + START_CHAR2 + data1 + …….. + data13
+ */
+static bool _pms7003_checksum_ok(const uint8_t *frame)
+{
+	unsigned int calc_checksum = 0;
+	int i;
+
+	for (i = 0; i < MAX_FRAME_LEN - 2; i++)
+		calc_checksum += frame[i];
+
+	if (calc_checksum != FRAME_WORD(frame + MAX_FRAME_LEN - 2)) {
+		_E("Checksum error, calc_checksum[0x%X] != [0x%X] checksum", calc_checksum, FRAME_WORD(frame + MAX_FRAME_LEN - 2));
+		return false;
+	}
+
+	return true;
+}
+
+/*
+ * find frames in rx_buf and decode the newest valid one into protocol.
+ * parsed frames and bytes which can not start a frame are dropped,
+ * an incomplete frame is kept at the front of rx_buf for the next read.
+ * returns true if a frame was decoded
+ */
+static bool _pms7003_scan(_pms7003_protocol_t *protocol)
+{
+	uint8_t *pos = rx_buf;
+	uint8_t *end = rx_buf + rx_len;
+	bool found = false;
+
+	while ((pos = memchr(pos, FRAME_START_CHAR1, end - pos)) != NULL) {
+		if (end - pos < 2)
+			break;		// wait for start character 2
+		if (pos[1] != FRAME_START_CHAR2) {
+			pos++;
+			continue;
+		}
+		if (end - pos < 4)
+			break;		// wait for frame length
+		if (FRAME_WORD(pos + 2) != FRAME_DATA_LEN) {
+			#ifdef DEBUG
+			_I("Frame syncing... frame_len [%u]", FRAME_WORD(pos + 2));
+			#endif
+			pos++;
+			continue;
+		}
+		if (end - pos < MAX_FRAME_LEN)
+			break;		// wait for the rest of the frame
 
-	// set Frame length = 2x13 + 2 (data+check bytes)
-	pms7003_protocol.frame_len = MAX_FRAME_LEN - sizeof(pms7003_protocol.checksum);
+		if (_pms7003_checksum_ok(pos)) {
+			_pms7003_parse(pos, protocol);
+			found = true;
+			pos += MAX_FRAME_LEN;
+		} else {
+			pos++;
+		}
+	}
+
+	if (pos == NULL) {
+		rx_len = 0;		// no start character left
+	} else {
+		rx_len = end - pos;
+		memmove(rx_buf, pos, rx_len);
+	}
+
+	return found;
+}
+
+/*
+ * read sensor data from PMS7003 and format.
+ * the UART is drained one byte per peripheral_uart_read() (see
+ * _uart_read_available()) into rx_buf, which is then scanned for frames.
+ * waits up to MAX_TRY_COUNT x 100ms for a complete frame
+ */
+bool resource_pms7003_read(void)
+{
+	int nread;
+	int try_again = 0;
 
 	if (!initialized) {
 		// open UART port and set UART handle resource
@@ -221,111 +339,30 @@ bool resource_pms7003_read(void)
 		}
 	}
 
-	while (!packet_received) {
-		 // read data from a slave device, block until data is received
-		if (resource_read_data(&data, 1, true) == false) {
+	memset(&pms7003_protocol, 0, sizeof(_pms7003_protocol_t));
+
+	while (!_pms7003_scan(&pms7003_protocol)) {
+		nread = _uart_read_available(rx_buf + rx_len, UART_RX_BUF_SIZE - rx_len);
+		if (nread < 0) {
 			_E("resource_read_data failed");
 			return false;
 		}
-
-		#ifdef DEBUG
-		_I("READ: [0x%02X]", incoming_byte);
-		#endif
-
-		if (!in_frame) {
-			if (data == 0x42 && byte_position == 0) {
-				#ifdef DEBUG
-				_I("READ: [0x%02X] ST1", data);
-				#endif
-				frame_buf[byte_position] = data;            // add start character 1 into buffer
-				pms7003_protocol.frame_header[0] = data;
-				calc_checksum = data;                       // add data to Checksum
-				byte_position++;                            // set to next position
-			}
-			else if (data == 0x4D && byte_position == 1) {
-				#ifdef DEBUG
-				_I("READ: [0x%02X] ST2", data);
-				#endif
-				frame_buf[byte_position] = data;            // add start character 2 into buffer
-				pms7003_protocol.frame_header[1] = data;
-				calc_checksum += data;                      // add data to Checksum
-
-				// we have valid frame header
-				in_frame = true;                                     // received start char 1[0x42] and char 2[0x4d]
-				byte_position++;                                     // set to next position
-			}
-			else {
-				// data is not in synced, ignore data
-				#ifdef DEBUG
-				_I("Frame syncing... [0x%02X]", data);
-				#endif
-			}
-		}
-		else {
-			#ifdef DEBUG
-			_I("READ: [0x%02X]", data);
-			#endif
-			// save data into frame buffer
-			frame_buf[byte_position] = data;
-			calc_checksum += data;
-			byte_position++;
-
-			unsigned int val = (frame_buf[byte_position - 1] & 0xff) + (frame_buf[byte_position - 2] << 8);
-			switch (byte_position) {
-			case 4:
-				pms7003_protocol.frame_len = val;
-				frame_len = val + byte_position;
-				#ifdef DEBUG
-				_I("frame_len: [%d]", frame_len);
-				#endif
-				break;
-			case 6:
-				pms7003_protocol.standard_particle.PM1_0 = val;
-				break;
-			case 8:
-				pms7003_protocol.standard_particle.PM2_5 = val;
-				break;
-			case 10:
-				pms7003_protocol.standard_particle.PM10 = val;
-				break;
-			case 12:
-				pms7003_protocol.atmospheric_env.PM1_0 = val;
-				break;
-			case 14:
-				pms7003_protocol.atmospheric_env.PM2_5 = val;
-				break;
-			case 16:
-				pms7003_protocol.atmospheric_env.PM10 = val;
-				break;
-			case 32:
-				pms7003_protocol.checksum = val;
-				calc_checksum -= ((val>>8) + (val&0xFF));
-				break;
-			default:
-				break;
-			}
-
-			// check if all data is received
-			if (byte_position >= frame_len) {
-				#ifdef DEBUG
-				_I("READ: byte_position[%d] : frame_len[%d]", byte_position, frame_len);
-				#endif
-				packet_received = true;
-				byte_position = 0;
-				in_frame = false;
+		if (nread == 0) {
+			// data is not ready, wait for next bytes
+			if (try_again++ >= MAX_TRY_COUNT) {
+				_D("No frame to receive");
+				return false;
 			}
+			usleep(100 * 1000);
+			continue;
 		}
+		#ifdef DEBUG
+		_I("READ: [%d] bytes, [%u] buffered", nread, rx_len + nread);
+		#endif
+		rx_len += nread;
 	}
 
-	// check received checksum and calculated checksum is same or not
-	// Checksum : Check code = START_CHAR1 + START_CHAR2 + data1 + …….. + data13
-	if (calc_checksum == pms7003_protocol.checksum) {
-		// save sensor data and return true
-		set_sensor_value(pms7003_protocol);
-		return true;
-	} else {
-		// return false
-		_E("Checksum error, calc_checksum[0x%X] != [0x%X] pms7003_protocol.checksum", calc_checksum, pms7003_protocol.checksum);
-		return false;
-	}
+	// save sensor data and return true
+	set_sensor_value(pms7003_protocol);
+	return true;
 }
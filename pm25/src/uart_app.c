@@ -10,6 +10,9 @@
 #include <stdio.h>
 #include <string.h>
 #include <stdlib.h>
+#include <time.h>
+#include <unistd.h>
+#include <pthread.h>
 #include <Ecore.h>
 #include "log.h"
 #include "thing_master_user.h"
@@ -23,9 +26,12 @@
 #include <sys/time.h>
 #endif
 
-#define EVENT_INTERVAL_SECOND	(1.0f)	// sensor event timer : 1 second interval
+#define EVENT_INTERVAL_MSEC	1000	// at most one sensor event per second
 
-Ecore_Timer *sensor_event_timer = NULL;
+static pthread_t sensor_thread;
+static bool sensor_thread_started = false;
+static int sensor_thread_done = 0;		// set by main loop to stop the reader thread
+static int sensor_event_pending = 0;	// an event is queued on the main loop
 pthread_mutex_t  mutex_lock = PTHREAD_MUTEX_INITIALIZER;
 static bool g_switch_status;
 static const char *RES_CAPABILITY_DUSTSENSOR_MAIN_0 = "/capability/dustSensor/main/0";
@@ -110,77 +116,133 @@ void get_fine_dust_level(uint32_t *fine_dust_level)
 	MUTEX_UNLOCK;
 }
 
-static Eina_Bool _sensor_interval_event_cb(void *data)
+/*
+ * main loop : send the latest sensor value, queued by the reader thread
+ */
+static void _sensor_event_cb(void *data)
 {
 	int error = SMARTTHINGS_RESOURCE_ERROR_NONE;
 	smartthings_payload_h resp_payload = NULL;
 	bool switch_status = false;
 
-	// read sensor data from PMS7003 module
-	if (!resource_pms7003_read()) {
-		_E("resource_pms7003_read Failed");
-
-		// cancel periodic event timer operation
-		return ECORE_CALLBACK_RENEW;
-	} else {
-		// get sensor value from PMS7003 module
-		uint32_t dust = 0;
-		uint32_t fine = 0;
-		get_dust_level(&dust);			// PM10 level
-		get_fine_dust_level(&fine);		// PM2.5 level
-
-		// send notification when switch is on state.
-		switch_status = _get_switch_status();
-		if (switch_status) {
-			#ifndef _DEBUG_PRINT_
-				struct timeval tv;
-				gettimeofday(&tv, NULL);
-				_I("[%d.%06d] dustLevel : %d ug/m3, fineDustLevel : %d ug/m3", tv.tv_sec, tv.tv_usec, dust, fine);
-			#endif
-
-			// send notification to cloud server
-			error = smartthings_payload_create(&resp_payload);
-			if (error != SMARTTHINGS_RESOURCE_ERROR_NONE || !resp_payload) {
-				_E("smartthings_payload_create() failed, [%d]", error);
-				return ECORE_CALLBACK_CANCEL;
-			}
-
-			error = smartthings_payload_set_int(resp_payload, PROP_DUSTLEVEL, (int)dust);
-			if (error != SMARTTHINGS_RESOURCE_ERROR_NONE) {
-				_E("smartthings_payload_set_int() failed, [%d]", error);
-				smartthings_payload_destroy(resp_payload);
-				return ECORE_CALLBACK_CANCEL;
-			}
-			error = smartthings_payload_set_int(resp_payload, PROP_FINEDUSTLEVEL, (int)fine);
-			if (error != SMARTTHINGS_RESOURCE_ERROR_NONE) {
-				_E("smartthings_payload_set_int() failed, [%d]", error);
-				smartthings_payload_destroy(resp_payload);
-				return ECORE_CALLBACK_CANCEL;
-			}
-
-			error = smartthings_resource_notify(st_handle, RES_CAPABILITY_DUSTSENSOR_MAIN_0, resp_payload);
-			if (error != SMARTTHINGS_RESOURCE_ERROR_NONE) {
-				_E("smartthings_resource_notify() failed, [%d]", error);
-				smartthings_payload_destroy(resp_payload);
-				return ECORE_CALLBACK_CANCEL;
-			}
-
-			if (smartthings_payload_destroy(resp_payload))
-				_E("smartthings_payload_destroy() failed");
+	__atomic_store_n(&sensor_event_pending, 0, __ATOMIC_RELEASE);
+	if (__atomic_load_n(&sensor_thread_done, __ATOMIC_ACQUIRE))
+		return;
+
+	// get sensor value from PMS7003 module
+	uint32_t dust = 0;
+	uint32_t fine = 0;
+	get_dust_level(&dust);			// PM10 level
+	get_fine_dust_level(&fine);		// PM2.5 level
+
+	// send notification when switch is on state.
+	switch_status = _get_switch_status();
+	if (switch_status) {
+		#ifndef _DEBUG_PRINT_
+			struct timeval tv;
+			gettimeofday(&tv, NULL);
+			_I("[%d.%06d] dustLevel : %d ug/m3, fineDustLevel : %d ug/m3", tv.tv_sec, tv.tv_usec, dust, fine);
+		#endif
+
+		// send notification to cloud server
+		error = smartthings_payload_create(&resp_payload);
+		if (error != SMARTTHINGS_RESOURCE_ERROR_NONE || !resp_payload) {
+			_E("smartthings_payload_create() failed, [%d]", error);
+			return;
+		}
+
+		error = smartthings_payload_set_int(resp_payload, PROP_DUSTLEVEL, (int)dust);
+		if (error != SMARTTHINGS_RESOURCE_ERROR_NONE) {
+			_E("smartthings_payload_set_int() failed, [%d]", error);
+			smartthings_payload_destroy(resp_payload);
+			return;
+		}
+		error = smartthings_payload_set_int(resp_payload, PROP_FINEDUSTLEVEL, (int)fine);
+		if (error != SMARTTHINGS_RESOURCE_ERROR_NONE) {
+			_E("smartthings_payload_set_int() failed, [%d]", error);
+			smartthings_payload_destroy(resp_payload);
+			return;
+		}
+
+		error = smartthings_resource_notify(st_handle, RES_CAPABILITY_DUSTSENSOR_MAIN_0, resp_payload);
+		if (error != SMARTTHINGS_RESOURCE_ERROR_NONE) {
+			_E("smartthings_resource_notify() failed, [%d]", error);
+			smartthings_payload_destroy(resp_payload);
+			return;
+		}
+
+		if (smartthings_payload_destroy(resp_payload))
+			_E("smartthings_payload_destroy() failed");
+	}
+}
+
+static unsigned long long _monotonic_ms(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (unsigned long long)ts.tv_sec * 1000 + ts.tv_nsec / 1000000;
+}
+
+/*
+ * reader thread : UART reception and frame parsing stay off the main loop,
+ * each new value is handed to the main loop asynchronously
+ */
+static void *_sensor_thread_main(void *arg)
+{
+	unsigned long long now, start;
+	unsigned long long last_event = 0;
+
+	_I("sensor reader thread started");
+
+	while (!__atomic_load_n(&sensor_thread_done, __ATOMIC_ACQUIRE)) {
+		// read sensor data from PMS7003 module, returns within about a second
+		start = _monotonic_ms();
+		if (!resource_pms7003_read()) {
+			// UART open or read error returns at once, retry once per interval
+			now = _monotonic_ms();
+			if (now - start < EVENT_INTERVAL_MSEC)
+				usleep((EVENT_INTERVAL_MSEC - (now - start)) * 1000);
+			continue;
 		}
+
+		now = _monotonic_ms();
+		if (now - last_event < EVENT_INTERVAL_MSEC)
+			continue;
+		// coalesce with an event the main loop has not handled yet
+		if (__atomic_exchange_n(&sensor_event_pending, 1, __ATOMIC_ACQ_REL))
+			continue;
+		last_event = now;
+		ecore_main_loop_thread_safe_call_async(_sensor_event_cb, NULL);
+	}
+
+	_I("sensor reader thread finished");
+	return NULL;
+}
+
+static bool _start_sensor_thread(void)
+{
+	int ret;
+
+	__atomic_store_n(&sensor_thread_done, 0, __ATOMIC_RELEASE);
+	ret = pthread_create(&sensor_thread, NULL, &_sensor_thread_main, NULL);
+	if (ret != 0) {
+		_E("sensor reader thread create failed, ret=%d", ret);
+		return false;
 	}
+	sensor_thread_started = true;
 
-	// reset next event timer
-	return ECORE_CALLBACK_RENEW;
+	return true;
 }
 
-static void _clear_timer_resource(void)
+static void _stop_sensor_thread(void)
 {
-	_I("clear_timer_resource...");
+	_I("stop_sensor_thread...");
 
-	if (sensor_event_timer) {
-		ecore_timer_del(sensor_event_timer);
-		sensor_event_timer = NULL;
+	if (sensor_thread_started) {
+		__atomic_store_n(&sensor_thread_done, 1, __ATOMIC_RELEASE);
+		pthread_join(sensor_thread, NULL);
+		sensor_thread_started = false;
 	}
 }
 
@@ -195,9 +257,8 @@ static bool service_app_create(void *user_data)
 		ret = false;
 	}
 
-	sensor_event_timer = ecore_timer_add(EVENT_INTERVAL_SECOND, _sensor_interval_event_cb, NULL);
-	if (!sensor_event_timer) {
-		_E("Failed to add sensor_event_timer");
+	if (!_start_sensor_thread()) {
+		_E("Failed to start sensor reader thread");
 		ret = false;
 	}
 	return ret;
@@ -205,7 +266,7 @@ static bool service_app_create(void *user_data)
 
 static void service_app_terminate(void *user_data)
 {
-	_clear_timer_resource();
+	_stop_sensor_thread();
 	resource_pms7003_fini();
 	_deinit_mutex();
 